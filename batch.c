@@ -0,0 +1,350 @@
+#include "batch.h"
+#include <stdlib.h>
+#include <string.h>
+
+// the kernels are written once against these macros, a vec holds one
+// 16 bit lane per game
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define LANES 16
+typedef __m256i vec;
+#define V_LOAD(p) _mm256_loadu_si256((const __m256i*)(p))
+#define V_STORE(p, a) _mm256_storeu_si256((__m256i*)(p), a)
+#define V_LOAD_U8(p) _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(p)))
+#define V_SET1(n) _mm256_set1_epi16(n)
+#define V_ZERO() _mm256_setzero_si256()
+#define V_AND(a, b) _mm256_and_si256(a, b)
+#define V_OR(a, b) _mm256_or_si256(a, b)
+#define V_ANDNOT(a, b) _mm256_andnot_si256(a, b)
+#define V_ADD(a, b) _mm256_add_epi16(a, b)
+#define V_SUB(a, b) _mm256_sub_epi16(a, b)
+#define V_SHL1(a) _mm256_slli_epi16(a, 1)
+#define V_SHR1(a) _mm256_srli_epi16(a, 1)
+#define V_EQ(a, b) _mm256_cmpeq_epi16(a, b)
+#define V_GT(a, b) _mm256_cmpgt_epi16(a, b)
+#define V_ANY(a) (!_mm256_testz_si256(a, a))
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define LANES 8
+typedef __m128i vec;
+#define V_LOAD(p) _mm_loadu_si128((const __m128i*)(p))
+#define V_STORE(p, a) _mm_storeu_si128((__m128i*)(p), a)
+#define V_LOAD_U8(p) _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(p)), _mm_setzero_si128())
+#define V_SET1(n) _mm_set1_epi16(n)
+#define V_ZERO() _mm_setzero_si128()
+#define V_AND(a, b) _mm_and_si128(a, b)
+#define V_OR(a, b) _mm_or_si128(a, b)
+#define V_ANDNOT(a, b) _mm_andnot_si128(a, b)
+#define V_ADD(a, b) _mm_add_epi16(a, b)
+#define V_SUB(a, b) _mm_sub_epi16(a, b)
+#define V_SHL1(a) _mm_slli_epi16(a, 1)
+#define V_SHR1(a) _mm_srli_epi16(a, 1)
+#define V_EQ(a, b) _mm_cmpeq_epi16(a, b)
+#define V_GT(a, b) _mm_cmpgt_epi16(a, b)
+#define V_ANY(a) (_mm_movemask_epi8(_mm_cmpeq_epi16(a, _mm_setzero_si128())) != 0xffff)
+#else
+#define LANES 1
+typedef uint16_t vec;
+#define V_LOAD(p) (*(const uint16_t*)(p))
+#define V_STORE(p, a) (*(uint16_t*)(p) = (a))
+#define V_LOAD_U8(p) ((vec)*(p))
+#define V_SET1(n) ((vec)(n))
+#define V_ZERO() ((vec)0)
+#define V_AND(a, b) ((vec)((a) & (b)))
+#define V_OR(a, b) ((vec)((a) | (b)))
+#define V_ANDNOT(a, b) ((vec)(~(a) & (b)))
+#define V_ADD(a, b) ((vec)((a) + (b)))
+#define V_SUB(a, b) ((vec)((a) - (b)))
+#define V_SHL1(a) ((vec)((a) << 1))
+#define V_SHR1(a) ((vec)((a) >> 1))
+#define V_EQ(a, b) ((vec)((a) == (b) ? 0xffff : 0))
+#define V_GT(a, b) ((vec)((int16_t)(a) > (int16_t)(b) ? 0xffff : 0))
+#define V_ANY(a) ((a) != 0)
+#endif
+
+#if defined(__AVX2__)
+const char batch_kernel[] = "avx2";
+#elif defined(__SSE2__)
+const char batch_kernel[] = "sse2";
+#else
+const char batch_kernel[] = "scalar";
+#endif
+
+// lanes are grouped in tiles of BATCH_ALIGN games with all of a tile's
+// rows next to each other, so a block's whole board is a few cache lines
+#define ROW(p, y, g) (&(p)[((g)/BATCH_ALIGN*BOARD_HEIGHT + (y))*BATCH_ALIGN + (g)%BATCH_ALIGN])
+
+static void placePiece(struct Batch* batch, int g, int type, int orientation, int x, int y) {
+    const struct Orientation* or = &orientations[type][orientation];
+    for (int m = 0; m < 4; m++)
+        batch->piece[m][g] = (row_t)or->rows[m] << x;
+
+    batch->type[g] = type;
+    batch->orientation[g] = orientation;
+    batch->x[g] = x;
+    batch->y[g] = y;
+}
+
+static void spawnPiece(struct Batch* batch, int g) {
+    unsigned char* queue = &batch->queue[g*QUEUE_CAPACITY];
+    int front = batch->queue_front[g];
+    int type = queue[front];
+
+    queue[front] = nextPiece(&batch->randomizers[g]);
+    batch->queue_front[g] = (front+1)%QUEUE_CAPACITY;
+    placePiece(batch, g, type, 0, BOARD_WIDTH/2, 0);
+}
+
+int initBatch(struct Batch* batch, int games, uint64_t seed, enum RandomizerMode mode) {
+    int count = (games + BATCH_ALIGN-1)/BATCH_ALIGN*BATCH_ALIGN;
+    int ok = 1;
+
+    batch->count = count;
+    batch->board = calloc(count*BOARD_HEIGHT, sizeof(row_t));
+    for (int m = 0; m < 4; m++)
+        ok &= (batch->piece[m] = calloc(count, sizeof(row_t))) != NULL;
+    batch->x = calloc(count, sizeof(int16_t));
+    batch->y = calloc(count, sizeof(int16_t));
+    batch->type = calloc(count, sizeof(int16_t));
+    batch->orientation = calloc(count, sizeof(int16_t));
+    batch->lines = calloc(count, sizeof(int16_t));
+    batch->alive = calloc(count, sizeof(uint16_t));
+    batch->queue = calloc(count, QUEUE_CAPACITY);
+    batch->queue_front = calloc(count, 1);
+    batch->randomizers = calloc(count, sizeof(struct Randomizer));
+
+    if (!ok || !batch->board || !batch->x || !batch->y || !batch->type || !batch->orientation
+            || !batch->lines || !batch->alive || !batch->queue || !batch->queue_front || !batch->randomizers) {
+        destroyBatch(batch);
+        return -1;
+    }
+
+    // padding lanes past games stay dead
+    for (int g = 0; g < games; g++) {
+        initRandomizer(&batch->randomizers[g], seed + g, mode);
+        batch->alive[g] = 0xffff;
+        placePiece(batch, g, nextPiece(&batch->randomizers[g]), 0, BOARD_WIDTH/2, 0);
+        fillPieces(&batch->randomizers[g], &batch->queue[g*QUEUE_CAPACITY], QUEUE_CAPACITY);
+    }
+    return 0;
+}
+
+void destroyBatch(struct Batch* batch) {
+    free(batch->board);
+    for (int m = 0; m < 4; m++)
+        free(batch->piece[m]);
+    free(batch->x);
+    free(batch->y);
+    free(batch->type);
+    free(batch->orientation);
+    free(batch->lines);
+    free(batch->alive);
+    free(batch->queue);
+    free(batch->queue_front);
+    free(batch->randomizers);
+    memset(batch, 0, sizeof(struct Batch));
+}
+
+int batchAlive(struct Batch* batch) {
+    int alive = 0;
+    for (int g = 0; g < batch->count; g++)
+        alive += batch->alive[g] != 0;
+    return alive;
+}
+
+// where each lane's piece would end up if it rotated
+struct Rotation {
+    row_t rows[4][LANES];
+    int16_t x[LANES];
+    int16_t y[LANES];
+    int16_t orientation[LANES];
+};
+
+// rotation looks up a different table entry per lane, so the candidate is
+// gathered here and tested in the vector pass like any other move. Same
+// kicks as rotate() in engine.c.
+static void rotateLane(struct Batch* batch, int g, int k, struct Rotation* rot) {
+    int orientation = (batch->orientation[g]+1)%4;
+    const struct Orientation* from = &orientations[batch->type[g]][batch->orientation[g]];
+    const struct Orientation* to = &orientations[batch->type[g]][orientation];
+
+    int x = batch->x[g] - from->dx + to->dx;
+    int y = batch->y[g] - from->dy + to->dy;
+
+    if (y + to->h > BOARD_HEIGHT)
+        y = BOARD_HEIGHT - to->h;
+    if (y < 0)
+        y = 0;
+    if (x + to->w > BOARD_WIDTH)
+        x = BOARD_WIDTH - to->w;
+    if (x < 0)
+        x = 0;
+
+    for (int m = 0; m < 4; m++)
+        rot->rows[m][k] = (row_t)to->rows[m] << x;
+    rot->x[k] = x;
+    rot->y[k] = y;
+    rot->orientation[k] = orientation;
+}
+
+// moves every row of lane g that isn't full down past the full ones below
+// it, bottom up in one pass. Nothing rests on an empty row, so the first
+// one ends the stack.
+static void compactLane(struct Batch* batch, int g) {
+    int dst = BOARD_HEIGHT-1;
+    int m = BOARD_HEIGHT-1;
+    for (; m >= 0 && *ROW(batch->board, m, g) != 0; m--) {
+        if (*ROW(batch->board, m, g) != FULL_ROW)
+            *ROW(batch->board, dst--, g) = *ROW(batch->board, m, g);
+    }
+    for (; dst > m; dst--)
+        *ROW(batch->board, dst, g) = 0;
+}
+
+// clears full rows in lanes that just locked a piece. Finding them is done
+// for the whole block, the few lanes that have any are compacted one by one.
+static void clearBlock(struct Batch* batch, int g0, vec locked) {
+    const vec full_row = V_SET1(FULL_ROW);
+    vec lines = V_LOAD(&batch->lines[g0]);
+    vec any = V_ZERO();
+
+    for (int y = 0; y < BOARD_HEIGHT; y++) {
+        vec full = V_AND(locked, V_EQ(V_LOAD(ROW(batch->board, y, g0)), full_row));
+        lines = V_SUB(lines, full);
+        any = V_OR(any, full);
+    }
+    if (!V_ANY(any))
+        return;
+    V_STORE(&batch->lines[g0], lines);
+
+    uint16_t lanes[LANES];
+    V_STORE(lanes, any);
+    for (int k = 0; k < LANES; k++) {
+        if (lanes[k])
+            compactLane(batch, g0+k);
+    }
+}
+
+static void stepBlock(struct Batch* batch, int g0, vec input, struct Rotation* rot, int lo, int hi) {
+    const vec left_col = V_SET1(1);
+    const vec right_col = V_SET1(1 << (BOARD_WIDTH-1));
+    const vec bottom = V_SET1(BOARD_HEIGHT-1);
+    vec alive = V_LOAD(&batch->alive[g0]);
+    vec px = V_LOAD(&batch->x[g0]);
+    vec py = V_LOAD(&batch->y[g0]);
+    vec po = V_LOAD(&batch->orientation[g0]);
+    vec piece[4];
+    for (int m = 0; m < 4; m++)
+        piece[m] = V_LOAD(&batch->piece[m][g0]);
+
+    vec is_left = V_AND(alive, V_EQ(input, V_SET1(INPUT_LEFT)));
+    vec is_right = V_AND(alive, V_EQ(input, V_SET1(INPUT_RIGHT)));
+    vec is_rotate = V_AND(alive, V_EQ(input, V_SET1(INPUT_ROTATE)));
+    vec is_hard = V_AND(alive, V_EQ(input, V_SET1(INPUT_HARD_DROP)));
+    vec is_drop = V_OR(is_hard, V_AND(alive, V_EQ(input, V_SET1(INPUT_DROP))));
+    vec locked = V_ZERO();
+
+    // hard drops repeat the pass until every one of them has locked
+    for (;;) {
+        vec moving = V_OR(V_OR(is_left, is_right), V_OR(is_drop, is_rotate));
+        if (!V_ANY(moving))
+            break;
+
+        // the masks are all ones, so subtracting one moves down a row
+        vec cy = V_OR(V_ANDNOT(is_rotate, V_SUB(py, is_drop)), V_AND(is_rotate, V_LOAD(rot->y)));
+        vec cand[4], at[4];
+        vec columns = V_ZERO();
+        vec bad = V_ZERO();
+        for (int m = 0; m < 4; m++) {
+            vec p = piece[m];
+            cand[m] = V_OR(V_OR(V_AND(is_left, V_SHR1(p)), V_AND(is_right, V_SHL1(p))),
+                    V_OR(V_AND(is_drop, p), V_AND(is_rotate, V_LOAD(rot->rows[m]))));
+            at[m] = V_ADD(cy, V_SET1(m));
+            // below the floor
+            bad = V_OR(bad, V_AND(cand[m], V_GT(at[m], bottom)));
+            columns = V_OR(columns, p);
+        }
+        bad = V_OR(bad, V_AND(columns, V_OR(V_AND(is_left, left_col), V_AND(is_right, right_col))));
+
+        // would the moved piece overlap the board
+        for (int y = lo; y <= hi; y++) {
+            vec row = V_SET1(y);
+            vec p = V_OR(V_OR(V_AND(V_EQ(at[0], row), cand[0]), V_AND(V_EQ(at[1], row), cand[1])),
+                    V_OR(V_AND(V_EQ(at[2], row), cand[2]), V_AND(V_EQ(at[3], row), cand[3])));
+            bad = V_OR(bad, V_AND(p, V_LOAD(ROW(batch->board, y, g0))));
+        }
+
+        vec ok = V_AND(moving, V_EQ(bad, V_ZERO()));
+        vec lock = V_ANDNOT(ok, is_drop);
+        vec turned = V_AND(ok, is_rotate);
+
+        for (int m = 0; m < 4; m++)
+            piece[m] = V_OR(V_ANDNOT(ok, piece[m]), V_AND(ok, cand[m]));
+        py = V_OR(V_ANDNOT(ok, py), V_AND(ok, cy));
+        px = V_SUB(V_ADD(px, V_AND(ok, is_left)), V_AND(ok, is_right));
+        px = V_OR(V_ANDNOT(turned, px), V_AND(turned, V_LOAD(rot->x)));
+        po = V_OR(V_ANDNOT(turned, po), V_AND(turned, V_LOAD(rot->orientation)));
+
+        if (V_ANY(lock)) {
+            for (int y = lo; y <= hi; y++) {
+                vec row = V_SET1(y);
+                vec p = V_OR(V_OR(V_AND(V_EQ(py, row), piece[0]), V_AND(V_EQ(V_ADD(py, V_SET1(1)), row), piece[1])),
+                        V_OR(V_AND(V_EQ(V_ADD(py, V_SET1(2)), row), piece[2]), V_AND(V_EQ(V_ADD(py, V_SET1(3)), row), piece[3])));
+                V_STORE(ROW(batch->board, y, g0), V_OR(V_LOAD(ROW(batch->board, y, g0)), V_AND(lock, p)));
+            }
+            locked = V_OR(locked, lock);
+        }
+
+        is_left = V_ZERO();
+        is_right = V_ZERO();
+        is_rotate = V_ZERO();
+        is_drop = V_AND(is_hard, ok);
+    }
+
+    V_STORE(&batch->x[g0], px);
+    V_STORE(&batch->y[g0], py);
+    V_STORE(&batch->orientation[g0], po);
+    for (int m = 0; m < 4; m++)
+        V_STORE(&batch->piece[m][g0], piece[m]);
+
+    if (!V_ANY(locked))
+        return;
+
+    // locking at the very top loses the game
+    vec lost = V_ANDNOT(V_GT(py, V_ZERO()), locked);
+    V_STORE(&batch->alive[g0], V_ANDNOT(lost, alive));
+
+    clearBlock(batch, g0, locked);
+
+    uint16_t lanes[LANES];
+    V_STORE(lanes, locked);
+    for (int k = 0; k < LANES; k++) {
+        if (lanes[k])
+            spawnPiece(batch, g0+k);
+    }
+}
+
+void batchStep(struct Batch* batch, const unsigned char* inputs) {
+    struct Rotation rot = {0};
+
+    for (int g0 = 0; g0 < batch->count; g0 += LANES) {
+        // only rows around the pieces can change, rotation kicks can lift
+        // a piece by two rows and hard drops can reach the floor
+        int lo = BOARD_HEIGHT, hi = 0;
+        for (int k = 0; k < LANES; k++) {
+            int g = g0+k;
+            if (inputs[g] == INPUT_ROTATE && batch->alive[g])
+                rotateLane(batch, g, k, &rot);
+            if (inputs[g] == INPUT_HARD_DROP)
+                hi = BOARD_HEIGHT;
+            if (batch->y[g] - 2 < lo)
+                lo = batch->y[g] - 2;
+            if (batch->y[g] + 4 > hi)
+                hi = batch->y[g] + 4;
+        }
+        lo = lo < 0 ? 0 : lo;
+        hi = hi > BOARD_HEIGHT-1 ? BOARD_HEIGHT-1 : hi;
+
+        stepBlock(batch, g0, V_LOAD_U8(&inputs[g0]), &rot, lo, hi);
+    }
+}
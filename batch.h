@@ -0,0 +1,42 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stdint.h>
+
+#include "engine.h"
+
+// games are stored side by side, row y of neighbouring games is next to
+// each other so one vector load picks up the same row of many games
+struct Batch {
+    // number of lanes, a multiple of BATCH_ALIGN
+    int count;
+    row_t* board;
+    // the active piece's row masks, already shifted to its column
+    row_t* piece[4];
+    int16_t* x;
+    int16_t* y;
+    int16_t* type;
+    int16_t* orientation;
+    int16_t* lines;
+    // 0xffff while the game is running, 0 once it is lost
+    uint16_t* alive;
+    unsigned char* queue;
+    unsigned char* queue_front;
+    struct Randomizer* randomizers;
+};
+
+#define BATCH_ALIGN 16
+// a row is one 16 bit lane
+_Static_assert(BOARD_WIDTH <= 16, "rows don't fit a lane");
+
+// name of the vector kernel batch.c was built with
+extern const char batch_kernel[];
+
+// game g gets the same pieces as initGame(game, seed + g, mode) would
+int initBatch(struct Batch* batch, int games, uint64_t seed, enum RandomizerMode mode);
+void destroyBatch(struct Batch* batch);
+// inputs holds one enum Input per lane, batch->count of them
+void batchStep(struct Batch* batch, const unsigned char* inputs);
+int batchAlive(struct Batch* batch);
+
+#endif
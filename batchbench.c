@@ -0,0 +1,80 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "batch.h"
+
+#define INPUT_ROUNDS 64
+
+double now() {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec/1e9;
+}
+
+// steps the same games with the same inputs through engine.c one game at
+// a time and through batch.c all at once, counting only steps taken by
+// games that are still running
+int main(int argc, char* argv[]) {
+    int games = argc > 1 ? atoi(argv[1]) : 4096;
+    int steps = argc > 2 ? atoi(argv[2]) : 1000;
+    unsigned seed = argc > 3 ? atoi(argv[3]) : 1;
+
+    // the inputs are drawn with seed, the games get seed+1 onwards
+    struct Batch batch;
+    if (initBatch(&batch, games, seed+1, RANDOM_UNIFORM) < 0) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+
+    // moves and soft drops only, hard drops would end games too quickly
+    unsigned char* inputs = calloc(batch.count, INPUT_ROUNDS);
+    struct Game* scalar = malloc(games*sizeof(struct Game));
+    if (!inputs || !scalar) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+    struct Rng rng;
+    seedRng(&rng, seed);
+    for (int n = 0; n < games*INPUT_ROUNDS; n++)
+        inputs[n/games*batch.count + n%games] = 1 + randomBelow(&rng, INPUT_DROP);
+
+    for (int g = 0; g < games; g++)
+        initGame(&scalar[g], seed+1 + g, RANDOM_UNIFORM);
+
+    // games still running are counted between steps, outside the timing,
+    // the same way for both
+    long scalar_steps = 0;
+    double scalar_secs = 0;
+    for (int n = 0; n < steps; n++) {
+        unsigned char* in = &inputs[(n%INPUT_ROUNDS)*batch.count];
+        for (int g = 0; g < games; g++)
+            scalar_steps += scalar[g].state == GAME;
+
+        double start = now();
+        for (int g = 0; g < games; g++)
+            step(&scalar[g], in[g]);
+        scalar_secs += now() - start;
+    }
+
+    long batch_steps = 0;
+    double batch_secs = 0;
+    for (int n = 0; n < steps; n++) {
+        batch_steps += batchAlive(&batch);
+
+        double start = now();
+        batchStep(&batch, &inputs[(n%INPUT_ROUNDS)*batch.count]);
+        batch_secs += now() - start;
+    }
+
+    printf("games: %d\n", games);
+    printf("steps: %d\n", steps);
+    printf("scalar game-steps/sec: %.0f\n", scalar_steps/scalar_secs);
+    printf("batch (%s) game-steps/sec: %.0f\n", batch_kernel, batch_steps/batch_secs);
+    printf("speedup: %.2fx\n", (batch_steps/batch_secs)/(scalar_steps/scalar_secs));
+
+    destroyBatch(&batch);
+    free(scalar);
+    free(inputs);
+    return 0;
+}
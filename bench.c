@@ -0,0 +1,256 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "engine.h"
+#include "zobrist.h"
+
+// snapshots only hold boards up to the standard size, see snapshot.h
+#if BOARD_WIDTH <= 10
+#define BENCH_SNAPSHOT
+#include "snapshot.h"
+#endif
+
+#ifdef BENCH_RENDER
+#include "pack.h"
+#include "render.h"
+#endif
+
+// every pass starts again from fresh copies of this many games, each with
+// its own seed so the pieces differ between them
+#define GAMES 1024
+#define RUNS 25
+// calls per game per pass for the cheap operations
+#define REPEATS 4
+
+enum Fixture {FIXTURE_EMPTY, FIXTURE_HALF, FIXTURE_TOPOUT, FIXTURE_COUNT};
+static const char* fixture_names[FIXTURE_COUNT] = {"empty", "half", "topout"};
+// rows filled from the bottom, each with a hole or two
+static const int fixture_rows[FIXTURE_COUNT] = {0, BOARD_HEIGHT/2, BOARD_HEIGHT-4};
+
+static struct Game fixtures[GAMES];
+static struct Game games[GAMES];
+
+static double now() {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec*1e9 + t.tv_nsec;
+}
+
+// game n gets seed+n, the same board fill comes from the same seed too
+static void makeFixtures(enum Fixture fixture, uint64_t seed, int full_rows) {
+    struct Rng rng;
+    seedRng(&rng, seed);
+
+    for (int g = 0; g < GAMES; g++) {
+        struct Game* game = &fixtures[g];
+        initGame(game, seed + g, RANDOM_UNIFORM);
+
+        for (int n = 0; n < fixture_rows[fixture]; n++) {
+            int y = BOARD_HEIGHT-1 - n;
+            row_t row = FULL_ROW & ~ROW_BIT(randomBelow(&rng, BOARD_WIDTH));
+            if (randomBelow(&rng, 2))
+                row &= ~ROW_BIT(randomBelow(&rng, BOARD_WIDTH));
+            game->board[y] = row;
+        }
+        // spread over the filled part, or the bottom rows of an empty board
+        for (int n = 0; n < full_rows; n++) {
+            int span = fixture_rows[fixture] > full_rows ? fixture_rows[fixture] : full_rows;
+            game->board[BOARD_HEIGHT-1 - n*span/full_rows] = FULL_ROW;
+        }
+
+        for (int y = 0; y < BOARD_HEIGHT; y++) {
+            for (int x = 0; x < BOARD_WIDTH; x++)
+                game->colors[y][x] = game->board[y] & ROW_BIT(x) ? randomBelow(&rng, 7) : -1;
+        }
+        columnHeights(game->board, game->heights);
+        game->hash = zobristGame(game);
+    }
+}
+
+// lowers every active piece onto the board without locking it
+static void restPieces() {
+    for (int g = 0; g < GAMES; g++) {
+        struct Piece* piece = &fixtures[g].active;
+        const struct Orientation* or = &orientations[piece->type][piece->orientation];
+        while (!collides(&fixtures[g], or, piece->x, piece->y+1))
+            piece->y++;
+    }
+}
+
+static void opMoveLeft(struct Game* game) {
+    for (int n = 0; n < REPEATS; n++)
+        moveLeft(game);
+}
+
+static void opMoveRight(struct Game* game) {
+    for (int n = 0; n < REPEATS; n++)
+        moveRight(game);
+}
+
+static void opRotate(struct Game* game) {
+    for (int n = 0; n < REPEATS; n++)
+        rotate(game);
+}
+
+// what every move, rotation and fall tests, here against the stack under a
+// resting piece and the spot above it
+static void opCollides(struct Game* game) {
+    const struct Piece* piece = &game->active;
+    const struct Orientation* or = &orientations[piece->type][piece->orientation];
+    for (int n = 0; n < REPEATS; n++)
+        collides(game, or, piece->x, piece->y + n%2);
+}
+
+static void opDrop(struct Game* game) {
+    drop(game);
+}
+
+// the whole board, drop_lock covers checking just the rows a piece touched
+static void opClearRows(struct Game* game) {
+    unsigned char rows[BOARD_HEIGHT];
+    clearRows(game, 0, BOARD_HEIGHT, rows);
+}
+
+static void opHardDrop(struct Game* game) {
+    step(game, INPUT_HARD_DROP);
+}
+
+// what the ghost piece and bots ask for
+static void opDropDistance(struct Game* game) {
+    for (int n = 0; n < REPEATS; n++)
+        dropDistance(game);
+}
+
+#ifdef BENCH_SNAPSHOT
+static struct Snapshot snapshot;
+
+static void opSnapshotSave(struct Game* game) {
+    saveSnapshot(&snapshot, game);
+}
+
+static void opSnapshotRoundTrip(struct Game* game) {
+    saveSnapshot(&snapshot, game);
+    loadSnapshot(game, &snapshot);
+}
+#endif
+
+#ifdef BENCH_RENDER
+static void opDrawBoard(struct Game* game) {
+    drawBoard(game);
+    flushSprites();
+}
+#endif
+
+struct Benchmark {
+    const char* name;
+    void (*op)(struct Game* game);
+    int ops_per_call;
+    // full rows put into the fixture, and whether pieces start resting on the board
+    int full_rows;
+    int rest;
+};
+
+static const struct Benchmark benchmarks[] = {
+    {"moveLeft", opMoveLeft, REPEATS, 0, 0},
+    {"moveRight", opMoveRight, REPEATS, 0, 0},
+    {"rotate", opRotate, REPEATS, 0, 0},
+    {"collides", opCollides, REPEATS, 0, 1},
+    // one row down from the spawn point
+    {"drop_fall", opDrop, 1, 0, 0},
+    // locking, clearing rows and dealing the next piece
+    {"drop_lock", opDrop, 1, 0, 1},
+    {"clearRows_none", opClearRows, 1, 0, 0},
+    {"clearRows_four", opClearRows, 1, 4, 0},
+    {"hard_drop", opHardDrop, 1, 0, 0},
+    {"dropDistance", opDropDistance, REPEATS, 0, 0},
+#ifdef BENCH_SNAPSHOT
+    {"snapshot_save", opSnapshotSave, 1, 0, 0},
+    {"snapshot_roundtrip", opSnapshotRoundTrip, 1, 0, 0},
+#endif
+#ifdef BENCH_RENDER
+    {"drawBoard", opDrawBoard, 1, 0, 0},
+#endif
+};
+
+// times RUNS passes over fresh copies of the fixtures, printing a csv line
+static void runBenchmark(const struct Benchmark* bench, enum Fixture fixture, uint64_t seed) {
+    double samples[RUNS];
+    double total = 0, best = 0;
+
+    makeFixtures(fixture, seed, bench->full_rows);
+    if (bench->rest)
+        restPieces();
+
+    // one pass untimed to warm the caches and branch predictors
+    memcpy(games, fixtures, sizeof(games));
+    for (int g = 0; g < GAMES; g++)
+        bench->op(&games[g]);
+
+    for (int r = 0; r < RUNS; r++) {
+        memcpy(games, fixtures, sizeof(games));
+        double start = now();
+        for (int g = 0; g < GAMES; g++)
+            bench->op(&games[g]);
+        samples[r] = (now() - start)/((double)GAMES*bench->ops_per_call);
+
+        total += samples[r];
+        if (r == 0 || samples[r] < best)
+            best = samples[r];
+    }
+
+    double mean = total/RUNS, variance = 0;
+    for (int r = 0; r < RUNS; r++)
+        variance += (samples[r] - mean)*(samples[r] - mean);
+    variance /= RUNS - 1;
+
+    printf("%s,%s,%.2f,%.0f,%.2f,%.2f,%d,%dx%d\n", bench->name, fixture_names[fixture],
+            mean, 1e9/mean, sqrt(variance), best, RUNS, BOARD_WIDTH, BOARD_HEIGHT);
+}
+
+// times the engine's hot paths, and drawBoard on a software renderer when
+// built with BENCH_RENDER, printing one csv line per benchmark and fixture
+int main(int argc, char* argv[]) {
+    uint64_t seed = argc > 1 ? strtoull(argv[1], NULL, 10) : 1;
+
+#ifdef BENCH_RENDER
+    SDL_SetHint(SDL_HINT_VIDEODRIVER, "dummy");
+    if (SDL_Init(SDL_INIT_VIDEO) != 0) {
+        fprintf(stderr, "couldn't initialize SDL: %s\n", SDL_GetError());
+        return 1;
+    }
+
+    SDL_Surface* target = SDL_CreateRGBSurfaceWithFormat(0, QUEUE_X + QUEUE_WIDTH*SQUARE_SIZE,
+            BOARD_Y + BOARD_HEIGHT*SQUARE_SIZE, 32, SDL_PIXELFORMAT_RGBA32);
+    if (target == NULL || (renderer = SDL_CreateSoftwareRenderer(target)) == NULL) {
+        fprintf(stderr, "couldn't create a software renderer: %s\n", SDL_GetError());
+        return 1;
+    }
+
+    struct Pack pack;
+    if (loadPack(&pack, "assets.pack") < 0) {
+        fprintf(stderr, "couldn't load assets.pack, run make pack\n");
+        return 1;
+    }
+    int loaded = initRender(&pack);
+    freePack(&pack);
+    if (loaded < 0)
+        return 1;
+#endif
+
+    printf("benchmark,fixture,ns_per_op,ops_per_sec,stddev_ns,min_ns,runs,board\n");
+    for (size_t b = 0; b < sizeof(benchmarks)/sizeof(benchmarks[0]); b++) {
+        for (int f = 0; f < FIXTURE_COUNT; f++)
+            runBenchmark(&benchmarks[b], f, seed);
+    }
+
+#ifdef BENCH_RENDER
+    destroyRender();
+    SDL_DestroyRenderer(renderer);
+    SDL_FreeSurface(target);
+    SDL_Quit();
+#endif
+    return 0;
+}
@@ -0,0 +1,245 @@
+#include "bot.h"
+#include "zobrist.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// weights from Yiyuan Lee's genetic search over these four features
+#define HEIGHT_WEIGHT -0.510066
+#define LINES_WEIGHT 0.760666
+#define HOLES_WEIGHT -0.35663
+#define BUMPINESS_WEIGHT -0.184483
+
+static double now() {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec/1e9;
+}
+
+static double evaluate(const row_t* board) {
+    int heights[BOARD_WIDTH] = {0};
+    int holes = 0, height = 0, bumpiness = 0;
+    row_t covered = 0;
+
+    for (int y = 0; y < BOARD_HEIGHT; y++) {
+        for (row_t top = board[y] & ~covered; top; top &= top-1)
+            heights[rowLowest(top)] = BOARD_HEIGHT - y;
+        holes += rowCount(covered & ~board[y]);
+        covered |= board[y];
+    }
+
+    for (int x = 0; x < BOARD_WIDTH; x++) {
+        height += heights[x];
+        if (x > 0)
+            bumpiness += abs(heights[x] - heights[x-1]);
+    }
+
+    return HEIGHT_WEIGHT*height + HOLES_WEIGHT*holes + BUMPINESS_WEIGHT*bumpiness;
+}
+
+// locks the piece into board and clears full rows, updating the board's
+// hash as it goes, returns the rows cleared
+static int place(row_t* board, uint64_t* hash, enum piece_type type, const struct Placement* placement) {
+    const struct Orientation* or = &orientations[type][(int)placement->orientation];
+    for (int m = 0; m < or->h; m++) {
+        int y = placement->y+m;
+        *hash ^= zobristRow(y, board[y]);
+        board[y] |= (row_t)or->rows[m] << placement->x;
+        *hash ^= zobristRow(y, board[y]);
+    }
+
+    int dst = BOARD_HEIGHT-1;
+    for (int m = BOARD_HEIGHT-1; m >= 0; m--) {
+        if (board[m] == FULL_ROW) {
+            *hash ^= zobristRow(m, FULL_ROW);
+        } else {
+            if (dst != m)
+                *hash ^= zobristRow(m, board[m]) ^ zobristRow(dst, board[m]);
+            board[dst--] = board[m];
+        }
+    }
+    int lines = dst+1;
+    for (; dst >= 0; dst--)
+        board[dst] = 0;
+    return lines;
+}
+
+// table data is the board's evaluation as a float in the low half, then
+// the depth and the search it was stored in
+static uint64_t tag(struct Bot* bot) {
+    return (uint64_t)bot->generation << 8 | bot->depth;
+}
+
+// fills in child from node after placing the piece, returns 0 if another
+// node at this depth already reached the same board
+static int makeChild(struct Bot* bot, const struct BotNode* node, struct BotNode* child, const struct Placement* placement) {
+    memcpy(child->board, node->board, sizeof(child->board));
+    child->hash = node->hash;
+    child->lines = node->lines + place(child->board, &child->hash, bot->type, placement);
+    child->first = bot->depth == 0 ? *placement : node->first;
+
+    // the same board at the same depth has the same lines cleared too, so
+    // the two are interchangeable and only the first needs searching
+    uint64_t data;
+    float value;
+    if (probeTable(&bot->table, child->hash, &data)) {
+        if (data >> 32 == tag(bot))
+            return 0;
+        uint32_t bits = data;
+        memcpy(&value, &bits, sizeof(value));
+    } else {
+        value = evaluate(child->board);
+    }
+
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    storeTable(&bot->table, child->hash, tag(bot) << 32 | bits);
+
+    child->value = value + LINES_WEIGHT*child->lines;
+    return 1;
+}
+
+static void expand(void* arg) {
+    struct BotJob* job = arg;
+    struct Bot* bot = job->bot;
+    struct Placement placements[MAX_PLACEMENTS];
+
+    for (int i = job->start; i < job->end; i++) {
+        struct BotNode* node = &bot->beam[i];
+        struct BotNode* children = &bot->children[i*MAX_PLACEMENTS];
+        bot->counts[i] = 0;
+
+        // the first depth always finishes so there is a move to make
+        if (bot->depth > 0 && now() > bot->deadline) {
+            atomic_store(&bot->timed_out, 1);
+            return;
+        }
+
+        struct Piece piece = {bot->type, 0, BOARD_WIDTH/2, 0};
+        int count = generatePlacements(node->board, &piece, placements);
+        int kept = 0;
+
+        for (int n = 0; n < count; n++)
+            kept += makeChild(bot, node, &children[kept], &placements[n]);
+        atomic_fetch_add(&bot->transpositions, count - kept);
+        bot->counts[i] = kept;
+    }
+}
+
+static int compareNodes(const void* a, const void* b) {
+    double va = ((const struct BotNode*)a)->value;
+    double vb = ((const struct BotNode*)b)->value;
+    return (va < vb) - (va > vb);
+}
+
+int initBot(struct Bot* bot, int threads, int width, int budget_ms) {
+    bot->width = width;
+    bot->budget_ms = budget_ms;
+    // a few jobs per thread so idle workers have something to steal
+    bot->job_count = threads*4 < width ? threads*4 : width;
+    bot->beam = malloc(width*sizeof(struct BotNode));
+    bot->children = malloc((size_t)width*MAX_PLACEMENTS*sizeof(struct BotNode));
+    bot->counts = malloc(width*sizeof(int));
+    bot->jobs = malloc(bot->job_count*sizeof(struct BotJob));
+    bot->generation = 0;
+
+    if (!bot->beam || !bot->children || !bot->counts || !bot->jobs || initTable(&bot->table, BOT_TABLE_BITS) < 0) {
+        free(bot->beam);
+        free(bot->children);
+        free(bot->counts);
+        free(bot->jobs);
+        return -1;
+    }
+
+    if (initPool(&bot->pool, threads) < 0) {
+        destroyTable(&bot->table);
+        free(bot->beam);
+        free(bot->children);
+        free(bot->counts);
+        free(bot->jobs);
+        return -1;
+    }
+    return 0;
+}
+
+void destroyBot(struct Bot* bot) {
+    destroyPool(&bot->pool);
+    destroyTable(&bot->table);
+    free(bot->beam);
+    free(bot->children);
+    free(bot->counts);
+    free(bot->jobs);
+}
+
+int botChoose(struct Bot* bot, const struct Game* game, struct Placement* placement) {
+    enum piece_type pieces[BOT_MAX_DEPTH];
+
+    int depths = 1;
+    unsigned char type;
+
+    pieces[0] = game->active.type;
+    while (depths < BOT_MAX_DEPTH && peekPieceRing(&game->queue, depths-1, &type) == 0)
+        pieces[depths++] = type;
+
+    memcpy(bot->beam[0].board, game->board, sizeof(game->board));
+    bot->beam[0].hash = game->hash ^ zobristPieces(game);
+    bot->beam[0].lines = 0;
+    bot->beam[0].value = 0;
+    bot->beam_size = 1;
+    bot->deadline = now() + bot->budget_ms/1000.0;
+    bot->depth_reached = 0;
+    bot->nodes = 0;
+    atomic_store(&bot->transpositions, 0);
+    atomic_store(&bot->timed_out, 0);
+    // 24 bits in the table, and never 0 so data is never 0
+    bot->generation = bot->generation % 0xffffff + 1;
+
+    for (int depth = 0; depth < depths; depth++) {
+        bot->depth = depth;
+        bot->type = pieces[depth];
+
+        // the active piece starts where it is now, later ones at spawn
+        if (depth == 0) {
+            struct Placement placements[MAX_PLACEMENTS];
+            int count = generatePlacements(game->board, &game->active, placements);
+            int kept = 0;
+            for (int n = 0; n < count; n++)
+                kept += makeChild(bot, &bot->beam[0], &bot->children[kept], &placements[n]);
+            atomic_fetch_add(&bot->transpositions, count - kept);
+            bot->counts[0] = kept;
+        } else {
+            int jobs = bot->job_count < bot->beam_size ? bot->job_count : bot->beam_size;
+            for (int n = 0; n < jobs; n++) {
+                bot->jobs[n].bot = bot;
+                bot->jobs[n].start = bot->beam_size*n/jobs;
+                bot->jobs[n].end = bot->beam_size*(n+1)/jobs;
+                poolSubmit(&bot->pool, expand, &bot->jobs[n]);
+            }
+            poolWait(&bot->pool);
+
+            // keep the last full depth rather than a partial one
+            if (atomic_load(&bot->timed_out))
+                break;
+        }
+
+        int total = 0;
+        for (int i = 0; i < bot->beam_size; i++) {
+            memmove(&bot->children[total], &bot->children[i*MAX_PLACEMENTS], bot->counts[i]*sizeof(struct BotNode));
+            total += bot->counts[i];
+        }
+        if (total == 0)
+            break;
+
+        qsort(bot->children, total, sizeof(struct BotNode), compareNodes);
+        bot->beam_size = total < bot->width ? total : bot->width;
+        memcpy(bot->beam, bot->children, bot->beam_size*sizeof(struct BotNode));
+        bot->depth_reached = depth+1;
+        bot->nodes += total;
+    }
+
+    if (bot->depth_reached == 0)
+        return -1;
+
+    *placement = bot->beam[0].first;
+    return 0;
+}
@@ -0,0 +1,63 @@
+#ifndef BOT_H
+#define BOT_H
+
+#include "engine.h"
+#include "movegen.h"
+#include "pool.h"
+#include "ttable.h"
+
+// the active piece plus every piece in the preview
+#define BOT_MAX_DEPTH (1 + QUEUE_CAPACITY)
+// 512KB so it stays in L2, a few times what one search stores
+#define BOT_TABLE_BITS 15
+
+struct BotNode {
+    row_t board[BOARD_HEIGHT];
+    uint64_t hash;
+    double value;
+    int lines;
+    // the move for the active piece that leads here
+    struct Placement first;
+};
+
+struct BotJob {
+    struct Bot* bot;
+    int start, end;
+};
+
+struct Bot {
+    struct Pool pool;
+    // evaluated boards, shared by the workers and kept between searches
+    struct TTable table;
+    // tags table entries with the search and depth that stored them
+    unsigned generation;
+    int width;
+    int budget_ms;
+
+    struct BotNode* beam;
+    int beam_size;
+    // MAX_PLACEMENTS slots for every node in the beam
+    struct BotNode* children;
+    int* counts;
+    struct BotJob* jobs;
+    int job_count;
+
+    // the depth being expanded and its piece
+    int depth;
+    enum piece_type type;
+    double deadline;
+    atomic_int timed_out;
+
+    // stats from the last botChoose
+    int depth_reached;
+    long nodes;
+    // children dropped because another move order reached the same board
+    atomic_long transpositions;
+};
+
+int initBot(struct Bot* bot, int threads, int width, int budget_ms);
+void destroyBot(struct Bot* bot);
+// picks where the active piece should go, -1 if it has nowhere to go
+int botChoose(struct Bot* bot, const struct Game* game, struct Placement* placement);
+
+#endif
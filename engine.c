@@ -0,0 +1,325 @@
+#include <string.h>
+
+#include "engine.h"
+#include "profile.h"
+#include "zobrist.h"
+
+// ticks per row at each level, from the NES version
+static const unsigned char gravity[] = {48, 43, 38, 33, 28, 23, 18, 13, 8, 6, 5, 5, 5, 4, 4, 4, 3, 3, 3, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 1};
+// score for clearing 0 to 4 rows at once, times level+1
+static const int line_scores[] = {0, 40, 100, 300, 1200};
+
+int initGame(struct Game* game, uint64_t seed, enum RandomizerMode mode) {
+    memset(game->board, 0, sizeof(game->board));
+    memset(game->colors, -1, sizeof(game->colors));
+    memset(game->heights, 0, sizeof(game->heights));
+    game->state = GAME;
+    game->score = 0;
+    game->lines = 0;
+    game->level = 0;
+    game->cleared = 0;
+    game->pieces = 0;
+    game->version = 0;
+
+    initRandomizer(&game->randomizer, seed, mode);
+    initPieceRing(&game->queue);
+
+    initActivePiece(game, nextPiece(&game->randomizer));
+    for (int n = 0; n < QUEUE_CAPACITY; n++)
+        pushPieceRing(&game->queue, nextPiece(&game->randomizer));
+
+    game->hash = zobristGame(game);
+    return 0;
+}
+
+int step(struct Game* game, enum Input input) {
+    if (game->state != GAME)
+        return -1;
+
+    switch (input) {
+        case INPUT_LEFT:
+            return moveLeft(game);
+        case INPUT_RIGHT:
+            return moveRight(game);
+        case INPUT_ROTATE:
+            return rotate(game);
+        case INPUT_DROP:
+            return drop(game);
+        case INPUT_HARD_DROP:
+            return hardDrop(game);
+        default:
+            return 0;
+    }
+}
+
+int tick(struct Game* game) {
+    if (game->state != GAME)
+        return 0;
+
+    if (++game->gravity_ticks < gravityTicks(game->level))
+        return 0;
+
+    game->gravity_ticks = 0;
+    drop(game);
+    return 1;
+}
+
+int gravityTicks(int level) {
+    int last = sizeof(gravity)/sizeof(gravity[0]) - 1;
+    return gravity[level < last ? level : last];
+}
+
+// how many more ticks until gravity moves the piece, counting the tick that does
+int ticksUntilDrop(struct Game* game) {
+    return gravityTicks(game->level) - game->gravity_ticks;
+}
+
+int drop(struct Game* game) {
+    PROFILE_SCOPE(PHASE_DROP);
+    struct Piece* piece = &game->active;
+    const struct Orientation* or = &orientations[piece->type][(int)piece->orientation];
+
+    if (!collides(game, or, piece->x, piece->y+1)) {
+        piece->y++;
+        return 0;
+    }
+
+    if (piece->y <= 0) {
+        game->state = LOST;
+    }
+
+    for (int m = 0; m < or->h; m++) {
+        row_t row = game->board[piece->y+m];
+        game->board[piece->y+m] |= (row_t)or->rows[m] << piece->x;
+        game->hash ^= zobristRow(piece->y+m, row) ^ zobristRow(piece->y+m, game->board[piece->y+m]);
+        for (int n = 0; n < or->w; n++) {
+            if (or->rows[m] & (1 << n)) {
+                game->colors[piece->y+m][piece->x+n] = piece->type;
+            }
+        }
+    }
+    // every column of a piece has a cell, rows top first, so the first
+    // found in each column is its highest
+    for (int n = 0; n < or->w; n++) {
+        int m = 0;
+        while (!(or->rows[m] & (1 << n)))
+            m++;
+        int height = BOARD_HEIGHT - (piece->y + m);
+        if (height > game->heights[piece->x+n])
+            game->heights[piece->x+n] = height;
+    }
+    // only the rows the piece went into can have filled up
+    int cleared = clearRows(game, piece->y, or->h, game->cleared_rows);
+    game->cleared = cleared;
+    game->pieces++;
+    game->score += line_scores[cleared]*(game->level+1);
+    game->lines += cleared;
+    game->level = game->lines/LINES_PER_LEVEL;
+    game->version++;
+
+    // every queued piece moves up a place, so rehash them all
+    game->hash ^= zobristPieces(game);
+    unsigned char type;
+
+    if (popPieceRing(&game->queue, &type) < 0) {
+        game->hash ^= zobristPieces(game);
+        return -1;
+    }
+
+    initActivePiece(game, type);
+    pushPieceRing(&game->queue, nextPiece(&game->randomizer));
+    game->hash ^= zobristPieces(game);
+
+    return -1;
+}
+
+int hardDrop(struct Game* game) {
+    struct Piece* piece = &game->active;
+    const struct Orientation* or = &orientations[piece->type][(int)piece->orientation];
+    piece->y = landingRow(game->board, game->heights, or, piece->x, piece->y);
+    return drop(game);
+}
+
+// clears the full rows among the count rows starting at top, writing their
+// indices to rows bottom first and returning how many there were
+int clearRows(struct Game* game, int top, int count, unsigned char* rows) {
+    PROFILE_SCOPE(PHASE_CLEAR_ROWS);
+    int cleared = 0;
+    for (int m = top+count-1; m >= top; m--) {
+        if (game->board[m] == FULL_ROW)
+            rows[cleared++] = m;
+    }
+    if (cleared == 0)
+        return 0;
+    game->version++;
+
+    // rows below the lowest full one stay where they are, the rest move
+    // down at most once each. Nothing rests on an empty row, so the first
+    // one ends the stack.
+    int dst = rows[0];
+    int m = rows[0];
+    for (; m >= 0 && game->board[m] != 0; m--) {
+        if (game->board[m] == FULL_ROW) {
+            game->hash ^= zobristRow(m, FULL_ROW);
+            continue;
+        }
+
+        game->hash ^= zobristRow(m, game->board[m]) ^ zobristRow(dst, game->board[m]);
+        game->board[dst] = game->board[m];
+        memcpy(game->colors[dst], game->colors[m], BOARD_WIDTH);
+        dst--;
+    }
+
+    // the rows the stack moved out of, everything above them is empty already
+    for (; dst > m; dst--) {
+        game->board[dst] = 0;
+        memset(game->colors[dst], -1, BOARD_WIDTH);
+    }
+    // a cleared row can uncover a hole, so heights can fall by more than
+    // the rows cleared
+    columnHeights(game->board, game->heights);
+    return cleared;
+}
+
+// pushes rows of garbage in from the bottom, each full but for the hole
+// column. Anything pushed off the top, or an active piece with nowhere left
+// to go, loses the game.
+int addGarbage(struct Game* game, int rows, int hole) {
+    if (rows <= 0)
+        return 0;
+    if (rows > BOARD_HEIGHT)
+        rows = BOARD_HEIGHT;
+
+    for (int m = 0; m < rows; m++) {
+        if (game->board[m])
+            game->state = LOST;
+    }
+
+    memmove(game->board, &game->board[rows], (BOARD_HEIGHT - rows)*sizeof(row_t));
+    memmove(game->colors, game->colors[rows], (BOARD_HEIGHT - rows)*BOARD_WIDTH);
+    for (int m = BOARD_HEIGHT - rows; m < BOARD_HEIGHT; m++) {
+        game->board[m] = FULL_ROW & ~ROW_BIT(hole);
+        memset(game->colors[m], GARBAGE, BOARD_WIDTH);
+        game->colors[m][hole] = -1;
+    }
+
+    // the piece moves up with the stack if it has to
+    struct Piece* piece = &game->active;
+    const struct Orientation* or = &orientations[piece->type][(int)piece->orientation];
+    while (collides(game, or, piece->x, piece->y) && piece->y > 0)
+        piece->y--;
+    if (collides(game, or, piece->x, piece->y))
+        game->state = LOST;
+
+    columnHeights(game->board, game->heights);
+    game->hash = zobristGame(game);
+    game->version++;
+    return 0;
+}
+
+// does a piece in the given orientation hit a wall, the floor or the board
+int collides(struct Game* game, const struct Orientation* or, int board_x, int board_y) {
+    if (board_x < 0 || board_y < 0 || board_x + or->w > BOARD_WIDTH || board_y + or->h > BOARD_HEIGHT)
+        return 1;
+
+    for (int m = 0; m < or->h; m++) {
+        if (game->board[board_y+m] & ((row_t)or->rows[m] << board_x))
+            return 1;
+    }
+    return 0;
+}
+
+void columnHeights(const row_t* board, unsigned char* heights) {
+    memset(heights, 0, BOARD_WIDTH);
+    row_t covered = 0;
+    for (int y = 0; y < BOARD_HEIGHT && covered != FULL_ROW; y++) {
+        for (row_t top = board[y] & ~covered; top; top &= top-1)
+            heights[rowLowest(top)] = BOARD_HEIGHT - y;
+        covered |= board[y];
+    }
+}
+
+int landingRow(const row_t* board, const unsigned char* heights, const struct Orientation* or, int x, int y) {
+    int land = BOARD_HEIGHT;
+    for (int n = 0; n < or->w; n++) {
+        // the lowest y that keeps this column's bottom cell above the stack
+        int column = BOARD_HEIGHT - heights[x+n] - 1 - or->skirt[n];
+        if (column < land)
+            land = column;
+    }
+    if (land >= y)
+        return land;
+
+    // the piece is under something, it can only fall to the next block
+    for (; y + or->h < BOARD_HEIGHT; y++) {
+        for (int m = 0; m < or->h; m++) {
+            if (board[y+1+m] & ((row_t)or->rows[m] << x))
+                return y;
+        }
+    }
+    return y;
+}
+
+int dropDistance(const struct Game* game) {
+    const struct Piece* piece = &game->active;
+    const struct Orientation* or = &orientations[piece->type][(int)piece->orientation];
+    return landingRow(game->board, game->heights, or, piece->x, piece->y) - piece->y;
+}
+
+int rotate(struct Game* game) {
+    PROFILE_SCOPE(PHASE_ROTATE);
+    struct Piece* piece = &game->active;
+    const struct Orientation* from = &orientations[piece->type][(int)piece->orientation];
+    int orientation = (piece->orientation+1)%4;
+    const struct Orientation* to = &orientations[piece->type][orientation];
+
+    int x = piece->x - from->dx + to->dx;
+    int y = piece->y - from->dy + to->dy;
+
+    // kick back inside the board before testing against it
+    if (y + to->h > BOARD_HEIGHT)
+        y = BOARD_HEIGHT - to->h;
+    if (y < 0)
+        y = 0;
+    if (x + to->w > BOARD_WIDTH)
+        x = BOARD_WIDTH - to->w;
+    if (x < 0)
+        x = 0;
+
+    if (collides(game, to, x, y))
+        return -1;
+
+    piece->orientation = orientation;
+    piece->x = x;
+    piece->y = y;
+    return 0;
+}
+
+int moveLeft(struct Game* game) {
+    struct Piece* piece = &game->active;
+    if (collides(game, &orientations[piece->type][(int)piece->orientation], piece->x-1, piece->y))
+        return -1;
+
+    piece->x--;
+    return 0;
+}
+
+int moveRight(struct Game* game) {
+    struct Piece* piece = &game->active;
+    if (collides(game, &orientations[piece->type][(int)piece->orientation], piece->x+1, piece->y))
+        return -1;
+
+    piece->x++;
+    return 0;
+}
+
+int initActivePiece(struct Game* game, enum piece_type type) {
+    struct Piece* piece = &game->active;
+
+    piece->type = type;
+    piece->orientation = 0;
+    piece->x = BOARD_WIDTH/2;
+    piece->y = 0;
+    game->gravity_ticks = 0;
+    return 0;
+}
@@ -0,0 +1,146 @@
+#ifndef ENGINE_H
+#define ENGINE_H
+
+#include <stdint.h>
+
+#include "piece.h"
+#include "ring.h"
+#include "rng.h"
+
+// The board's size is fixed when the engine is compiled, so every loop over
+// it has constant bounds. Build with -DBOARD_WIDTH=64 -DBOARD_HEIGHT=64 and
+// so on for another size, each size is its own build.
+#ifndef BOARD_WIDTH
+#define BOARD_WIDTH 10
+#endif
+#ifndef BOARD_HEIGHT
+#define BOARD_HEIGHT 24
+#endif
+// pieces shown in the preview
+#ifndef QUEUE_CAPACITY
+#define QUEUE_CAPACITY 3
+#endif
+// logic ticks per second, gravity is counted in ticks
+#define TICK_RATE 60
+#define LINES_PER_LEVEL 10
+
+// the color of garbage rows, after the seven piece types
+#define GARBAGE 7
+
+// One bit per column, bit n is column n, in the smallest integer that
+// holds a row. Past 64 columns a row is two words, which gcc handles as
+// one integer so the engine's bit tricks work on it unchanged.
+#if BOARD_WIDTH <= 16
+typedef uint16_t row_t;
+#elif BOARD_WIDTH <= 32
+typedef uint32_t row_t;
+#elif BOARD_WIDTH <= 64
+typedef uint64_t row_t;
+#else
+typedef unsigned __int128 row_t;
+#endif
+
+_Static_assert(BOARD_WIDTH <= 128, "no row type for this board width");
+// heights and cleared rows are kept in bytes
+_Static_assert(BOARD_HEIGHT <= 255, "rows are numbered in a byte");
+
+// the cell at column n
+#define ROW_BIT(n) ((row_t)1 << (n))
+#define FULL_ROW ((row_t)(ROW_BIT(BOARD_WIDTH-1) | (ROW_BIT(BOARD_WIDTH-1) - 1)))
+
+// the lowest column set in a row that isn't empty
+static inline int rowLowest(row_t row) {
+#if BOARD_WIDTH <= 64
+    return __builtin_ctzll(row);
+#else
+    return (uint64_t)row ? __builtin_ctzll((uint64_t)row) : 64 + __builtin_ctzll((uint64_t)(row >> 64));
+#endif
+}
+
+static inline int rowCount(row_t row) {
+#if BOARD_WIDTH <= 64
+    return __builtin_popcountll(row);
+#else
+    return __builtin_popcountll((uint64_t)row) + __builtin_popcountll((uint64_t)(row >> 64));
+#endif
+}
+
+// the preview, holding piece types, front first. Only ever used from the
+// thread running the game, so it is the unpadded ring.
+DEFINE_LOCAL_RING(PieceRing, unsigned char, 4)
+_Static_assert(QUEUE_CAPACITY <= 4, "the preview doesn't fit its ring");
+
+enum States {MENU, LOST, GAME, ABOUT};
+
+enum Input {INPUT_NONE, INPUT_LEFT, INPUT_RIGHT, INPUT_ROTATE, INPUT_DROP, INPUT_HARD_DROP};
+
+struct Game {
+    row_t board[BOARD_HEIGHT];
+    // piece colors or GARBAGE, only used for drawing
+    char colors[BOARD_HEIGHT][BOARD_WIDTH];
+    // rows up to the highest block in each column, 0 for an empty one,
+    // kept up to date as pieces lock and rows clear
+    unsigned char heights[BOARD_WIDTH];
+
+    struct Piece active;
+
+    struct PieceRing queue;
+    struct Randomizer randomizer;
+
+    // zobrist hash of the board, the active piece type and the queue,
+    // kept up to date as pieces lock and rows clear
+    uint64_t hash;
+
+    enum States state;
+    int score;
+    int lines;
+    int level;
+    // pieces locked so far
+    int pieces;
+    // ticks since the active piece last fell
+    int gravity_ticks;
+
+    // rows cleared by the last piece to lock, bottom first, as they were
+    // numbered before clearing
+    unsigned char cleared_rows[4];
+    int cleared;
+
+    // goes up whenever the stack, the queue or the scores change: a piece
+    // locking, rows clearing or garbage coming in. The renderer redraws
+    // what it keeps of the game only when this moves.
+    unsigned version;
+};
+
+// the seed and mode decide every piece the game will get
+int initGame(struct Game* game, uint64_t seed, enum RandomizerMode mode);
+int step(struct Game* game, enum Input input);
+// advances the game by one tick, returns 1 if gravity moved the piece
+int tick(struct Game* game);
+int gravityTicks(int level);
+int ticksUntilDrop(struct Game* game);
+
+int initActivePiece(struct Game* game, enum piece_type type);
+
+int moveLeft(struct Game* game);
+int moveRight(struct Game* game);
+int rotate(struct Game* game);
+int drop(struct Game* game);
+// drops the active piece straight to where it lands and locks it
+int hardDrop(struct Game* game);
+// rows needs room for count indices
+int clearRows(struct Game* game, int top, int count, unsigned char* rows);
+
+int addGarbage(struct Game* game, int rows, int hole);
+
+int collides(struct Game* game, const struct Orientation* or, int board_x, int board_y);
+
+// fills heights from the board, for boards kept without them
+void columnHeights(const row_t* board, unsigned char* heights);
+// the y a piece at x, y comes to rest at falling straight down. From above
+// the stack that is one lookup per column, under an overhang it falls back
+// to testing a row at a time.
+int landingRow(const row_t* board, const unsigned char* heights, const struct Orientation* or, int x, int y);
+// how many rows the active piece would fall, for the ghost piece
+int dropDistance(const struct Game* game);
+
+#endif
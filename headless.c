@@ -0,0 +1,254 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "bot.h"
+#include "engine.h"
+#include "replay.h"
+#include "versus.h"
+
+#define MAX_STEPS 100000
+// versus games are cut off here, and remote inputs arrive up to this late
+#define VERSUS_TICKS 20000
+#define MAX_DELAY 24
+
+// replays every file and checks they end where they were recorded to
+static int verifyReplays(int count, char* paths[]) {
+    int failed = 0;
+    uint64_t ticks = 0;
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (int n = 0; n < count; n++) {
+        struct Replay replay;
+        struct Game game;
+        if (loadReplay(&replay, paths[n]) < 0) {
+            printf("%s: couldn't read replay\n", paths[n]);
+            failed++;
+            continue;
+        }
+
+        if (playReplay(&replay, &game) < 0) {
+            printf("%s: ended with score %d, %d lines, hash %016llx, recorded score %d, %d lines, hash %016llx\n", paths[n],
+                    game.score, game.lines, (unsigned long long)game.hash, replay.score, replay.lines, (unsigned long long)replay.hash);
+            failed++;
+        }
+        ticks += replay.ticks;
+        freeReplay(&replay);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double secs = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec)/1e9;
+
+    printf("replays: %d\n", count);
+    printf("failed: %d\n", failed);
+    printf("ticks: %llu\n", (unsigned long long)ticks);
+    printf("times realtime: %.0f\n", secs > 0 ? (double)ticks/TICK_RATE/secs : 0);
+    return failed ? 1 : 0;
+}
+
+// plays versus games twice, once with both players' inputs on time and
+// once through a rollback with the remote player's arriving late and
+// out of step, and checks both end the same
+static int verifyRollback(int games, uint64_t seed) {
+    static unsigned char inputs[VERSUS_TICKS][2];
+    static uint64_t arrivals[VERSUS_TICKS];
+    static struct Rollback rollback;
+    struct RollbackStats total = {0};
+    int failed = 0;
+    long frames = 0;
+    struct Rng rng;
+    seedRng(&rng, seed);
+
+    for (int g = 0; g < games; g++) {
+        struct Versus truth;
+        initVersus(&truth, seed+1 + g, RANDOM_BAG);
+
+        // mostly idle ticks, as with a person playing
+        int ticks = 0;
+        for (; ticks < VERSUS_TICKS && versusWinner(&truth) < 0; ticks++) {
+            for (int p = 0; p < 2; p++)
+                inputs[ticks][p] = randomBelow(&rng, 4) ? INPUT_NONE : 1 + randomBelow(&rng, INPUT_HARD_DROP);
+            versusTick(&truth, inputs[ticks]);
+        }
+
+        // each remote input arrives some ticks after it happened, in order,
+        // and only ticks with an input or every eighth one are sent at all
+        uint64_t delay = 0;
+        for (int t = 0; t < ticks; t++) {
+            int step = randomBelow(&rng, 3);
+            delay = step == 0 && delay > 0 ? delay-1 : step == 1 && delay < MAX_DELAY ? delay+1 : delay;
+            arrivals[t] = t + delay;
+            if (t > 0 && arrivals[t] < arrivals[t-1])
+                arrivals[t] = arrivals[t-1];
+        }
+
+        initRollback(&rollback, seed+1 + g, RANDOM_BAG);
+        int sent = 0;
+        for (uint64_t now = 0; rollback.state.ticks < (uint64_t)ticks || sent < ticks; now++) {
+            for (; sent < ticks && arrivals[sent] <= now; sent++) {
+                if (inputs[sent][1] != INPUT_NONE || sent % 8 == 7 || sent == ticks-1)
+                    remoteInput(&rollback, sent, inputs[sent][1]);
+            }
+            if (rollback.state.ticks < (uint64_t)ticks)
+                advanceRollback(&rollback, inputs[rollback.state.ticks][0]);
+            frames++;
+        }
+        reconcileRollback(&rollback);
+
+        for (int p = 0; p < 2; p++) {
+            struct Game* a = &truth.players[p];
+            struct Game* b = &rollback.state.players[p];
+            if (a->hash != b->hash || a->score != b->score || a->state != b->state || truth.garbage[p] != rollback.state.garbage[p]) {
+                printf("game %d: player %d ended with hash %016llx, expected %016llx\n", g, p,
+                        (unsigned long long)b->hash, (unsigned long long)a->hash);
+                failed++;
+                break;
+            }
+        }
+
+        struct RollbackStats* stats = &rollback.stats;
+        total.ticks += stats->ticks;
+        total.stalls += stats->stalls;
+        total.rollbacks += stats->rollbacks;
+        total.resimulated += stats->resimulated;
+        total.snapshot_ns += stats->snapshot_ns;
+        total.rollback_ns += stats->rollback_ns;
+        if (stats->snapshot_max_ns > total.snapshot_max_ns)
+            total.snapshot_max_ns = stats->snapshot_max_ns;
+        if (stats->rollback_max_ns > total.rollback_max_ns)
+            total.rollback_max_ns = stats->rollback_max_ns;
+    }
+
+    printf("games: %d\n", games);
+    printf("failed: %d\n", failed);
+    printf("ticks: %ld\n", total.ticks);
+    printf("stalls: %ld\n", total.stalls);
+    printf("rollbacks: %ld, %.1f ticks each\n", total.rollbacks, total.rollbacks ? (double)total.resimulated/total.rollbacks : 0);
+    printf("snapshot: %.0f ns average, %.0f ns worst\n", total.ticks ? total.snapshot_ns/total.ticks : 0, total.snapshot_max_ns);
+    printf("rollback per frame: %.0f ns average, %.0f ns worst, budget %d ns\n",
+            frames ? total.rollback_ns/frames : 0, total.rollback_max_ns, ROLLBACK_BUDGET_NS);
+    return failed ? 1 : 0;
+}
+
+// writes a random remote player for main -V, one "tick input" line per
+// tick with an input or every eighth tick, delay_ms late and in real time
+static int feedRemote(int delay_ms, uint64_t seed) {
+    struct Rng rng;
+    seedRng(&rng, seed);
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (uint64_t t = 0;; t++) {
+        enum Input input = randomBelow(&rng, 6) ? INPUT_NONE : 1 + randomBelow(&rng, INPUT_HARD_DROP);
+        if (input == INPUT_NONE && t % 8 != 7)
+            continue;
+
+        uint64_t due = t*1000000000ull/TICK_RATE + delay_ms*1000000ull;
+        struct timespec at = {start.tv_sec + (start.tv_nsec + due)/1000000000, (start.tv_nsec + due)%1000000000};
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &at, NULL) != 0);
+
+        if (printf("%llu %d\n", (unsigned long long)t, input) < 0 || fflush(stdout) == EOF)
+            return 0;
+    }
+}
+
+// plays games without a window, with random inputs or with -a the bot,
+// -b deals pieces from 7-bags, or with -v checks replays instead. -V checks
+// versus rollbacks over games games, -f delay_ms feeds main -V a remote player
+// whose inputs are drawn from seed.
+int main(int argc, char* argv[]) {
+    int games = 1000;
+    unsigned seed = time(0);
+    int autoplay = 0, versus = 0, positional = 0;
+    // -1 unless feeding a remote player
+    int feed_delay = -1;
+    enum RandomizerMode mode = RANDOM_UNIFORM;
+    long steps = 0, total_score = 0;
+    struct Bot bot;
+
+    for (int n = 1; n < argc; n++) {
+        if (!strcmp(argv[n], "-v"))
+            return verifyReplays(argc - n - 1, &argv[n+1]);
+        else if (!strcmp(argv[n], "-V"))
+            versus = 1;
+        else if (!strcmp(argv[n], "-f") && n+1 < argc)
+            feed_delay = atoi(argv[++n]);
+        else if (!strcmp(argv[n], "-a"))
+            autoplay = 1;
+        else if (!strcmp(argv[n], "-b"))
+            mode = RANDOM_BAG;
+        else if (positional++ == 0)
+            games = atoi(argv[n]);
+        else
+            seed = atoi(argv[n]);
+    }
+
+    // after parsing, so a seed given after -f is the one it uses
+    if (feed_delay >= 0)
+        return feedRemote(feed_delay, seed);
+    if (versus)
+        return verifyRollback(games, seed);
+
+    if (autoplay && initBot(&bot, cpuCount(), 64, 50) < 0) {
+        fprintf(stderr, "Couldn't start the bot\n");
+        return 1;
+    }
+
+    // the inputs are drawn with seed, the games get seed+1 onwards
+    struct Rng rng;
+    seedRng(&rng, seed);
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (int g = 0; g < games; g++) {
+        struct Game game;
+        initGame(&game, seed+1 + g, mode);
+
+        for (int n = 0; n < MAX_STEPS && game.state == GAME;) {
+            if (!autoplay) {
+                step(&game, 1 + randomBelow(&rng, INPUT_HARD_DROP));
+                steps++;
+                n++;
+                continue;
+            }
+
+            struct Placement placement;
+            enum Input path[MAX_PLACEMENTS];
+            int length = -1;
+            if (botChoose(&bot, &game, &placement) == 0)
+                length = findPath(game.board, &game.active, &placement, path, MAX_PLACEMENTS);
+            if (length < 0)
+                break;
+
+            for (int k = 0; k < length; k++)
+                step(&game, path[k]);
+            steps += length;
+            n += length;
+        }
+        total_score += game.score;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double secs = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec)/1e9;
+
+    printf("games: %d\n", games);
+    printf("steps: %ld\n", steps);
+    printf("average score: %.2f\n", games ? (double)total_score/games : 0);
+    printf("games/sec: %.0f\n", games/secs);
+    printf("steps/sec: %.0f\n", steps/secs);
+
+    if (autoplay) {
+        struct TTable* table = &bot.table;
+        struct TableStats stats;
+        tableStats(table, &stats);
+        printf("table probes: %ld\n", stats.probes);
+        printf("table hit rate: %.2f%%\n", stats.probes ? 100.0*stats.hits/stats.probes : 0);
+        printf("table collisions: %ld\n", stats.collisions);
+        printf("table overwrites: %ld of %ld stores\n", stats.overwrites, stats.stores);
+        destroyBot(&bot);
+    }
+    return 0;
+}
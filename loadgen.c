@@ -0,0 +1,275 @@
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "pool.h"
+#include "protocol.h"
+#include "rng.h"
+
+#define MAX_EVENTS 64
+#define MAX_PIPELINE 64
+
+struct Client {
+    int fd;
+    int moves;
+    // inputs in flight and the reply bytes still to come for them
+    int batch;
+    int expected;
+    int lost;
+    uint64_t sent_at;
+    int in_length;
+    unsigned char in[sizeof(struct StateReply) + MAX_PIPELINE*sizeof(struct MoveReply)];
+};
+
+static struct sockaddr_un address = {.sun_family = AF_UNIX};
+static int total_sessions = 10000;
+static int moves_per_session = 200;
+static int pipeline = 8;
+static atomic_int sessions_started;
+static atomic_long moves_made;
+static atomic_int failures;
+
+// nanoseconds from sending each move to its reply arriving
+static uint32_t* latencies;
+static atomic_long latency_count;
+
+static uint64_t now() {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec*1000000000ull + t.tv_nsec;
+}
+
+// sends the next pipeline of random moves, with a new game first when
+// starting out
+static int sendBatch(struct Client* client, struct Rng* rng, uint64_t seed, int first) {
+    unsigned char out[MSG_NEW_SIZE + MAX_PIPELINE];
+    int length = 0;
+    client->expected = 0;
+
+    if (first) {
+        out[length++] = MSG_NEW;
+        memcpy(&out[length], &seed, sizeof(seed));
+        length += sizeof(seed);
+        out[length++] = RANDOM_UNIFORM;
+        client->expected += sizeof(struct StateReply);
+    }
+
+    client->batch = pipeline;
+    if (client->batch > moves_per_session - client->moves)
+        client->batch = moves_per_session - client->moves;
+    for (int n = 0; n < client->batch; n++)
+        out[length++] = 1 + randomBelow(rng, INPUT_HARD_DROP);
+    client->expected += client->batch*sizeof(struct MoveReply);
+
+    client->sent_at = now();
+    for (int sent = 0; sent < length;) {
+        ssize_t n = send(client->fd, &out[sent], length - sent, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0)
+            return -1;
+        sent += n;
+    }
+    return 0;
+}
+
+// connects a new session if there are any left to run
+static int startSession(struct Client* client, int epoll, struct Rng* rng) {
+    int session = atomic_fetch_add(&sessions_started, 1);
+    if (session >= total_sessions)
+        return -1;
+
+    client->fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (client->fd < 0 || connect(client->fd, (struct sockaddr*)&address, sizeof(address)) < 0) {
+        if (client->fd >= 0)
+            close(client->fd);
+        atomic_fetch_add(&failures, 1);
+        return -1;
+    }
+
+    client->moves = 0;
+    client->lost = 0;
+    client->in_length = 0;
+    struct epoll_event event = {EPOLLIN, {.ptr = client}};
+    if (epoll_ctl(epoll, EPOLL_CTL_ADD, client->fd, &event) < 0 || sendBatch(client, rng, session, 1) < 0) {
+        close(client->fd);
+        atomic_fetch_add(&failures, 1);
+        return -1;
+    }
+    return 0;
+}
+
+// takes in whatever replies have arrived, returns 1 once the session is
+// over, -1 if the server went away
+static int readReplies(struct Client* client, struct Rng* rng) {
+    ssize_t got = recv(client->fd, &client->in[client->in_length], client->expected - client->in_length, 0);
+    if (got < 0 && (errno == EINTR || errno == EAGAIN))
+        return 0;
+    if (got <= 0)
+        return -1;
+    client->in_length += got;
+    if (client->in_length < client->expected)
+        return 0;
+
+    uint64_t arrived = now();
+    int n = 0;
+    if (client->in[0] == REPLY_STATE)
+        n += sizeof(struct StateReply);
+    for (; n < client->in_length; n += sizeof(struct MoveReply)) {
+        struct MoveReply reply;
+        memcpy(&reply, &client->in[n], sizeof(reply));
+        if (reply.kind != REPLY_MOVE)
+            return -1;
+        if (reply.state != GAME)
+            client->lost = 1;
+
+        long sample = atomic_fetch_add(&latency_count, 1);
+        latencies[sample] = arrived - client->sent_at;
+    }
+    client->moves += client->batch;
+    atomic_fetch_add(&moves_made, client->batch);
+    client->in_length = 0;
+
+    if (client->lost || client->moves >= moves_per_session)
+        return 1;
+    return sendBatch(client, rng, 0, 0) < 0 ? -1 : 0;
+}
+
+struct LoadWorker {
+    pthread_t thread;
+    int clients;
+    uint64_t seed;
+};
+
+// keeps its share of the concurrent sessions going until every session
+// has been started and finished
+static void* runLoadWorker(void* arg) {
+    struct LoadWorker* worker = arg;
+    struct Client* clients = malloc(worker->clients*sizeof(struct Client));
+    int epoll = epoll_create1(EPOLL_CLOEXEC);
+    struct Rng rng;
+    seedRng(&rng, worker->seed);
+
+    int active = 0;
+    for (int n = 0; clients && epoll >= 0 && n < worker->clients; n++)
+        active += startSession(&clients[n], epoll, &rng) == 0;
+
+    struct epoll_event events[MAX_EVENTS];
+    while (active > 0) {
+        int count = epoll_wait(epoll, events, MAX_EVENTS, -1);
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count < 0)
+            break;
+
+        for (int n = 0; n < count; n++) {
+            struct Client* client = events[n].data.ptr;
+            int result = readReplies(client, &rng);
+            if (result == 0)
+                continue;
+            if (result < 0)
+                atomic_fetch_add(&failures, 1);
+
+            epoll_ctl(epoll, EPOLL_CTL_DEL, client->fd, NULL);
+            close(client->fd);
+            if (startSession(client, epoll, &rng) < 0)
+                active--;
+        }
+    }
+
+    if (epoll >= 0)
+        close(epoll);
+    free(clients);
+    return NULL;
+}
+
+static int compareLatencies(const void* a, const void* b) {
+    uint32_t x = *(const uint32_t*)a, y = *(const uint32_t*)b;
+    return (x > y) - (x < y);
+}
+
+// plays -n sessions of up to -m random moves against the server, -c at a
+// time spread over -t threads, sending -p moves per write
+int main(int argc, char* argv[]) {
+    char* path = "tetris.sock";
+    int concurrency = 256;
+    int threads = cpuCount();
+
+    for (int n = 1; n < argc; n++) {
+        if (!strcmp(argv[n], "-c") && n+1 < argc)
+            concurrency = atoi(argv[++n]);
+        else if (!strcmp(argv[n], "-n") && n+1 < argc)
+            total_sessions = atoi(argv[++n]);
+        else if (!strcmp(argv[n], "-m") && n+1 < argc)
+            moves_per_session = atoi(argv[++n]);
+        else if (!strcmp(argv[n], "-p") && n+1 < argc)
+            pipeline = atoi(argv[++n]);
+        else if (!strcmp(argv[n], "-t") && n+1 < argc)
+            threads = atoi(argv[++n]);
+        else
+            path = argv[n];
+    }
+    if (pipeline < 1 || pipeline > MAX_PIPELINE || moves_per_session < 1 || total_sessions < 1) {
+        fprintf(stderr, "-p must be 1 to %d, -m and -n at least 1\n", MAX_PIPELINE);
+        return 1;
+    }
+    if (concurrency > total_sessions)
+        concurrency = total_sessions;
+    if (threads > concurrency)
+        threads = concurrency;
+    if (threads > POOL_MAX_THREADS)
+        threads = POOL_MAX_THREADS;
+    if (threads < 1)
+        threads = 1;
+    if (strlen(path) >= sizeof(address.sun_path)) {
+        fprintf(stderr, "%s is too long for a socket path\n", path);
+        return 1;
+    }
+    strcpy(address.sun_path, path);
+
+    latencies = malloc((size_t)total_sessions*moves_per_session*sizeof(uint32_t));
+    if (latencies == NULL) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+
+    struct LoadWorker workers[POOL_MAX_THREADS];
+    uint64_t start = now();
+    for (int n = 0; n < threads; n++) {
+        workers[n].clients = concurrency/threads + (n < concurrency%threads);
+        workers[n].seed = n;
+        if (pthread_create(&workers[n].thread, NULL, runLoadWorker, &workers[n]) != 0) {
+            fprintf(stderr, "couldn't start thread %d\n", n);
+            return 1;
+        }
+    }
+    for (int n = 0; n < threads; n++)
+        pthread_join(workers[n].thread, NULL);
+    double secs = (now() - start)/1e9;
+
+    long count = atomic_load(&latency_count);
+    qsort(latencies, count, sizeof(uint32_t), compareLatencies);
+
+    int finished = total_sessions - atomic_load(&failures);
+    printf("sessions: %d\n", finished);
+    printf("failures: %d\n", atomic_load(&failures));
+    printf("moves: %ld\n", atomic_load(&moves_made));
+    printf("sessions/sec: %.0f\n", finished/secs);
+    printf("moves/sec: %.0f\n", atomic_load(&moves_made)/secs);
+    if (count > 0) {
+        printf("move latency p50: %.1f us\n", latencies[count/2]/1e3);
+        printf("move latency p99: %.1f us\n", latencies[count*99/100]/1e3);
+        printf("move latency max: %.1f us\n", latencies[count-1]/1e3);
+    }
+
+    free(latencies);
+    return atomic_load(&failures) ? 1 : 0;
+}
@@ -1,741 +1,759 @@
 #include <SDL2/SDL.h>
-#include <SDL2/SDL_image.h>
+#ifdef PROFILE
 #include <SDL2/SDL_ttf.h>
+#endif
+#include <errno.h>
+#include <fcntl.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
+#include <unistd.h>
 
-#include "piece.h"
-#include "queue.h"
+#include "bot.h"
+#include "engine.h"
+#include "profile.h"
+#include "render.h"
+#include "replay.h"
+#include "snapshot.h"
+#include "triple.h"
+#include "versus.h"
 
 #define NO_STDIO_REDIRECT
 #define SCREEN_WIDTH 400
 #define SCREEN_HEIGHT 800
 #define PATH_LENGTH 50
-#define CK_RED 0xFF
-#define CK_GREEN 0xFF
-#define CK_BLUE 0xFF
-#define SQUARE_SIZE 16
-#define BOARD_WIDTH 10
-#define BOARD_HEIGHT 24
-#define BOARD_X 0
-#define BOARD_Y 0
-
-#define QUEUE_WIDTH 6
-#define QUEUE_HEIGHT 12 
-const int QUEUE_X = BOARD_WIDTH*SQUARE_SIZE;
-#define QUEUE_Y 0
-
-#define QUEUE_CAPACITY 3
-
-enum States {MENU, LOST, GAME, ABOUT} state = GAME;
-
-char i[4][1] = {{I}, {I}, {I}, {I}};
-char j[3][2] = {{J, -1}, {J, -1}, {J, J}};
-char l[3][2] = {{L, L}, {L, -1}, {L, -1}};
-char o[2][2] = {{O, O}, {O, O}};
-char s[3][2] = {{-1, S}, {S, S}, {S, -1}};
-char t[3][2] = {{T, -1}, {T, T}, {T, -1}};
-char z[3][2] = {{Z, -1}, {Z, Z}, {-1, Z}};
-
-char shape[4][4];
+#define PACK_PATH "assets.pack"
+// F5 saves the game here and F9 loads it back
+#define SAVE_PATH "tetris.save"
 
 SDL_Window* window;
-SDL_Renderer* renderer;
-
-TTF_Font *font;
-
-SDL_Texture* textures[7];
-SDL_Texture* text_cache[5];
-
-char board[BOARD_WIDTH][BOARD_HEIGHT];
-
-struct Queue queue;
-struct Piece queue_array[QUEUE_CAPACITY];
-
-SDL_Texture* loadImageTexture(char* path);
-SDL_Texture* loadTextTexture(char* text, SDL_Color fg, SDL_Color bg);
-
-int initActivePiece(enum piece_type type, struct Piece* piece);
-int initQueuePiece(struct Piece* piece);
-
-void drawBoard();
-void drawQueue();
-int drawActivePiece(struct Piece* piece);
-
-void getRealCoords(struct Piece* piece, int* x, int* y);
-int moveLeft(struct Piece* piece);
-int moveRight(struct Piece* piece);
-int rotate(struct Piece* piece);
-int drop(struct Piece* piece);
-
-int rotateShape(struct Piece* piece, char shp[4][4]);
-int getRotatedMap(struct Piece* piece, int* w, int* h);
-
-int score = 0;
-int level = 0;
-
-void printShape();
-
-void drawLostDialog();
-void clearRows();
+int screen_width = SCREEN_WIDTH;
+
+// everything from here to the frames belongs to the simulation thread,
+// once it has started
+struct Game game;
+
+// the bot plays instead of the keyboard, one input per tick
+int autoplay = 0;
+struct Bot bot;
+enum Input path[MAX_PLACEMENTS];
+int path_length = 0, path_pos = 0;
+// the game the path was planned for, a piece locking early makes it stale
+uint64_t path_hash;
+
+// at most this many ticks are run to catch up, past that time is dropped
+#define MAX_CATCH_UP (TICK_RATE/4)
+
+Uint64 ticks_done = 0;
+// the game has changed since the last frame was published
+int dirty = 1;
+
+// with -r every input goes to a replay file as it is applied
+int recording = 0;
+struct ReplayWriter replay;
+
+// with -V the keyboard plays against a remote player whose inputs come in
+// as "tick input" lines, ticks don't wait for them but roll back when one
+// turns out to differ from the guess
+int versus = 0;
+struct Rollback rollback;
+int remote_fd = -1;
+int remote_gone = 0;
+// the simulation is too far ahead of the remote player to tick
+int stalled = 0;
+char remote_lines[256];
+int remote_length = 0;
+
+// The simulation hands each state it reaches to the render thread as a
+// frame, through a triple buffer so neither ever waits for the other. A
+// slow present holds up drawing but not gravity or inputs.
+struct Frame {
+    // players[1] is the remote player in versus
+    struct Game players[2];
+    int player_count;
+    int winner;
+    Uint64 ticks;
+    // inputs applied so far, to tell which presses a frame shows
+    long applied;
+    // SDL_GetTicks when it was published, to slide the piece down from
+    Uint32 published;
+};
+DEFINE_TRIPLE(FrameBuffer, struct Frame)
+struct FrameBuffer frames;
+// pushed when a frame is published, to wake the render thread
+Uint32 frame_event;
+// frames replaced before they were drawn, counted by the simulation, and
+// frames drawn again with nothing new in them, counted by the renderer
+long dropped_frames = 0;
+long duplicated_frames = 0;
+// with -i the active piece slides down between rows and every vsync draws
+int interpolate = 0;
+
+// key presses wait here, stamped with when SDL saw them, until the tick
+// they fall on. Pushing one wakes the simulation.
+#define MAX_PENDING 64
+struct TimedInput {
+    enum Input input;
+    Uint32 time;
+};
+DEFINE_RING(InputRing, struct TimedInput, MAX_PENDING)
+struct InputRing pending;
+SDL_sem* wake;
+
+// F5 and F9 have the simulation save or load between ticks
+enum Command {COMMAND_NONE, COMMAND_SAVE, COMMAND_LOAD};
+atomic_int command = COMMAND_NONE;
+
+// when each applied input was pressed, in the order they were applied.
+// applied counts them, frames carry the count so the renderer knows which
+// ones a present shows.
+#define MAX_APPLIED 256
+DEFINE_RING(TimeRing, Uint32, MAX_APPLIED)
+struct TimeRing applied_times;
+long applied = 0, shown = 0;
+long latency_count = 0;
+double latency_total = 0;
+Uint32 latency_max = 0;
+
+// when main started, to time how long the first frame takes to show
+Uint64 launched;
+int presented = 0;
+
+atomic_int running = 1;
+// the window needs drawing again with no new frame
+int redraw = 0;
+
+#ifdef PROFILE
+// F3 shows p50/p99/max for every phase, refreshed twice a second, and the
+// histograms are written to <profile_path>.csv and .json on exit
+// The simulation's phases are read while that thread is still adding to
+// them, which can leave a line a sample out.
+#define OVERLAY_REFRESH_MS 500
+#define OVERLAY_X 8
+#define OVERLAY_Y (BOARD_HEIGHT*SQUARE_SIZE + 8)
+TTF_Font* overlay_font;
+SDL_Texture* overlay_lines[PHASE_COUNT];
+int overlay = 0;
+Uint32 overlay_updated = 0;
+char* profile_path = "profile";
+
+void drawOverlay();
+void dumpProfile();
+#endif
+
+
+void handleEvent(SDL_Event* e);
+void play(enum Input input);
+void applyInputs(Uint32 time);
+void autoplayStep();
+void saveGame();
+void loadGame();
+void readRemote();
+int versusStep(Uint32 time);
+void runCommand();
+void publish();
+int simulate(void* data);
+void render(const struct Frame* frame);
 
 int main(int argc, char* argv[]) {
+    launched = SDL_GetPerformanceCounter();
     SDL_Event e;
-
-    srand(time(0));
-
-    initQueue(&queue, queue_array, QUEUE_CAPACITY);
-
-    for (int n = 0; n < QUEUE_CAPACITY; n++) {
-        struct Piece temp = {rand()%7, 0, 0, 0, 0, 0, 0};
-        initQueuePiece(&temp);
-        enqueue(&queue, temp);
+    int budget_ms = 100;
+    int threads = cpuCount();
+    uint64_t seed = time(0);
+    enum RandomizerMode mode = RANDOM_UNIFORM;
+    char* replay_path = NULL;
+    char* remote_path = NULL;
+
+    for (int n = 1; n < argc; n++) {
+        if (!strcmp(argv[n], "-a"))
+            autoplay = 1;
+        else if (!strcmp(argv[n], "-t") && n+1 < argc)
+            budget_ms = atoi(argv[++n]);
+        else if (!strcmp(argv[n], "-j") && n+1 < argc)
+            threads = atoi(argv[++n]);
+        else if (!strcmp(argv[n], "-r") && n+1 < argc)
+            replay_path = argv[++n];
+        else if (!strcmp(argv[n], "-b"))
+            mode = RANDOM_BAG;
+        else if (!strcmp(argv[n], "-V") && n+1 < argc)
+            remote_path = argv[++n];
+        else if (!strcmp(argv[n], "-s") && n+1 < argc)
+            seed = strtoull(argv[++n], NULL, 10);
+        else if (!strcmp(argv[n], "-i"))
+            interpolate = 1;
+#ifdef PROFILE
+        else if (!strcmp(argv[n], "-p") && n+1 < argc)
+            profile_path = argv[++n];
+#endif
+    }
+
+    if (autoplay && initBot(&bot, threads, 64, budget_ms) < 0) {
+        SDL_Log("Couldn't start the bot.\n");
+        return -1;
     }
 
-    SDL_Log("size: %d\n", queue.size);
+    initGame(&game, seed, mode);
+    initInputRing(&pending);
 
-    struct Piece active_piece;
-    initActivePiece(L, &active_piece);
+    // both sides have to start from the same seed, -s sets it
+    if (remote_path) {
+        remote_fd = strcmp(remote_path, "-") ? open(remote_path, O_RDONLY | O_NONBLOCK) : 0;
+        if (remote_fd < 0 || fcntl(remote_fd, F_SETFL, fcntl(remote_fd, F_GETFL) | O_NONBLOCK) < 0) {
+            SDL_Log("Couldn't open %s for the remote player.\n", remote_path);
+            return -1;
+        }
+        initRollback(&rollback, seed, mode);
+        versus = 1;
+        autoplay = 0;
+        replay_path = NULL;
+        screen_width = 2*PLAYER_WIDTH;
+    }
 
-    memset(board, -1, sizeof(board));
+    if (replay_path) {
+        if (openReplay(&replay, replay_path, seed, mode) < 0) {
+            SDL_Log("Couldn't open %s to record to.\n", replay_path);
+            return -1;
+        }
+        recording = 1;
+    }
 
     if (SDL_Init(SDL_INIT_VIDEO) != 0) {
         SDL_Log("Couldn't initialize SDL.\n");
         return -1;
     }
 
-    int flags = IMG_INIT_PNG;
-    if ((IMG_Init(flags) & flags) != flags) {
-        SDL_Log("Failed to initialize PNG loading\n");
-        return -1;
-    }
-
+#ifdef PROFILE
     if (TTF_Init() < 0) {
         SDL_Log("Failed to initialize SDL_ttf.\n");
         return -1;
     }
+#endif
 
-    if ((window = SDL_CreateWindow("Tetris", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, SCREEN_WIDTH, SCREEN_HEIGHT, 0)) == NULL) {
+    if ((window = SDL_CreateWindow("Tetris", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, screen_width, SCREEN_HEIGHT, 0)) == NULL) {
         SDL_Log ("Couldn't create window.\n");
         return -1;
     }
 
-    if ((renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED)) == NULL) {
+    if ((renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC)) == NULL) {
         SDL_Log("Couldn't initialize renderer.\n");
         return -1;
     }
 
-    font = TTF_OpenFont("fonts/OpenSans-Regular.ttf", 24);
-    if (font == NULL) {
-        SDL_Log("Failed to load font: %s\n", TTF_GetError());
+    // the sprites and glyphs, baked by make pack
+    struct Pack pack;
+    if (loadPack(&pack, PACK_PATH) < 0) {
+        SDL_Log("Couldn't load %s, run make pack to build it.\n", PACK_PATH);
         return -1;
     }
+    int loaded = initRender(&pack);
+    freePack(&pack);
+    if (loaded < 0)
+        return -1;
 
-    SDL_Rect rect;
-    rect.x = 0;
-    rect.y = 0;
-    rect.w = 48;
-    rect.h = 32;
-
-    textures[I] = loadImageTexture("img/i.png");
-    textures[J] = loadImageTexture("img/j.png");
-    textures[L] = loadImageTexture("img/l.png");
-    textures[O] = loadImageTexture("img/o.png");
-    textures[S] = loadImageTexture("img/s.png");
-    textures[T] = loadImageTexture("img/t.png");
-    textures[Z] = loadImageTexture("img/z.png");
-
-    SDL_Color grey = {0x7f, 0x7f, 0x7f};
-    SDL_Color white = {0, 0, 0};
-    text_cache[0] = loadTextTexture("GAME OVER", white, grey);
-
-    while (1) {
-        while (SDL_PollEvent(&e)) {
-            if (e.type == SDL_QUIT) {
-                return 0;
-                break;
-            } else if (e.type == SDL_KEYDOWN) {
-                switch (e.key.keysym.scancode) {
-                    case SDL_SCANCODE_LEFT:
-                        switch (state) {
-                            case GAME:
-                                moveLeft(&active_piece);
-                                break;
-                        }
-                        break;
-
-                    case SDL_SCANCODE_RIGHT:
-                        switch (state) {
-                            case GAME:
-                                moveRight(&active_piece);
-                                break;
-                        }
-                        break;
-
-                    case SDL_SCANCODE_UP:
-                        switch (state) {
-                            case GAME:
-                                rotate(&active_piece);
-                                break;
-                        }
-                        break;
-
-                    case SDL_SCANCODE_DOWN:
-                        switch (state) {
-                            case GAME:
-                                drop(&active_piece);
-                                break;
-                        }
-                        break;
-
-                    case SDL_SCANCODE_SPACE:
-                        switch (state) {
-                            case GAME:
-                                while (drop(&active_piece) == 0);
-                                break;
-                        }
-                        break;
-                }
-            }
-        }
-
-        SDL_RenderClear(renderer);
-
-        SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
-        SDL_RenderFillRect(renderer, NULL);
-
-        switch (state) {
-            // leave break out, should still draw game in background
-            case LOST:
-                drawQueue();
-                drawBoard();
-                //drawActivePiece(&active_piece);
-                drawLostDialog();
-                break;
-            case GAME:
-                drawQueue();
-                drawBoard();
-                drawActivePiece(&active_piece);
-                break;
-        }
-
-        SDL_RenderPresent(renderer);
+#ifdef PROFILE
+    overlay_font = TTF_OpenFont("fonts/OpenSans-Regular.ttf", 12);
+    if (overlay_font == NULL) {
+        SDL_Log("Failed to load font: %s\n", TTF_GetError());
+        return -1;
+    }
+#endif
 
-        SDL_Delay(50);
+    initFrameBuffer(&frames);
+    initTimeRing(&applied_times);
+    frame_event = SDL_RegisterEvents(1);
+    if (frame_event == (Uint32)-1 || (wake = SDL_CreateSemaphore(0)) == NULL) {
+        SDL_Log("Couldn't set up the simulation thread.\n");
+        return -1;
     }
 
-    for (int i = 0; i < sizeof(textures)/sizeof(textures); i++) {
-        SDL_DestroyTexture(textures[i]);
+    // the first frame is there before anything waits for one
+    publish();
+    SDL_Thread* simulation = SDL_CreateThread(simulate, "simulation", NULL);
+    if (simulation == NULL) {
+        SDL_Log("Couldn't start the simulation thread.\n");
+        return -1;
     }
 
-    TTF_Quit();
-    IMG_Quit();
-    SDL_DestroyRenderer(renderer);
-    SDL_DestroyWindow(window);
+    while (atomic_load(&running)) {
+        // sleep until an event or a new frame comes in, unless sliding the
+        // piece down needs every vsync drawn
+        if (!interpolate && SDL_WaitEvent(&e))
+            handleEvent(&e);
 
-    SDL_Quit();
-}
+        PROFILE_BEGIN(PHASE_EVENTS);
+        while (SDL_PollEvent(&e))
+            handleEvent(&e);
+        PROFILE_END(PHASE_EVENTS);
 
-int drop(struct Piece* piece) {
-    int board_x = (piece->real_x - BOARD_X)/SQUARE_SIZE;
-    int board_y = (piece->real_y - BOARD_Y)/SQUARE_SIZE;
-
-    int w = (piece->orientation & 1) ? piece->h/SQUARE_SIZE : piece->w/SQUARE_SIZE;
-    int h = (piece->orientation & 1) ? piece->w/SQUARE_SIZE : piece->h/SQUARE_SIZE;
-    if (piece->real_y + ((piece->orientation & 1) ? piece->w: piece->h) + SQUARE_SIZE <= BOARD_Y + BOARD_HEIGHT*SQUARE_SIZE) {
-
-        for (int n = 0; n < w; n++) {
-            for (int m = h-1; m >= 0; m--) {
-                if (shape[n][m] >= 0) {
-                    if (board[board_x+n][board_y+m+1] >= 0) {
-                        goto after;
-                    }
-                }
-            }
+        int fresh;
+        const struct Frame* frame = readFrameBuffer(&frames, &fresh);
+        if (fresh || redraw || interpolate) {
+            if (!fresh)
+                duplicated_frames++;
+            render(frame);
         }
-        piece->y += SQUARE_SIZE;
-        piece->real_y += SQUARE_SIZE;
-        return 0;
-    }
-    after:
-    
-    if (piece->real_y <= 0) {
-        state = LOST;
     }
 
+    SDL_SemPost(wake);
+    SDL_WaitThread(simulation, NULL);
 
-    for (int n = 0; n < w; n++) {
-        for (int m = 0; m < h; m++) {
-            if (board[board_x+n][board_y+m] < shape[n][m]) {
-                board[board_x+n][board_y+m] = shape[n][m];
-            }
-        }
-    }
-    clearRows();
+    if (recording && closeReplay(&replay, ticks_done, &game) < 0)
+        SDL_Log("Couldn't finish writing %s.\n", replay_path);
 
-    struct Piece* p = dequeue(&queue);
+    if (latency_count > 0)
+        SDL_Log("input to present latency: %ld inputs, %.1f ms average, %u ms worst\n", latency_count, latency_total/latency_count, latency_max);
+    SDL_Log("frames: %ld dropped, %ld duplicated\n", dropped_frames, duplicated_frames);
 
-    if (p == NULL) {
-        SDL_Log("dequeue pointer is null");
-        SDL_Log("size: %d\n", queue.size);
-        return -1;
+    if (versus) {
+        struct RollbackStats* stats = &rollback.stats;
+        SDL_Log("rollback: %ld ticks, %ld stalls, %ld rollbacks resimulating %ld ticks\n", stats->ticks, stats->stalls, stats->rollbacks, stats->resimulated);
+        if (stats->ticks > 0)
+            SDL_Log("snapshot %.0f ns average, %.0f ns worst\n", stats->snapshot_ns/stats->ticks, stats->snapshot_max_ns);
+        if (stats->rollbacks > 0)
+            SDL_Log("rollback %.1f us average, %.1f us worst\n", stats->rollback_ns/stats->rollbacks/1e3, stats->rollback_max_ns/1e3);
+        if (remote_fd > 0)
+            close(remote_fd);
     }
-    memcpy(piece, p, sizeof(struct Piece));
-    initActivePiece(piece->type, piece);
-    struct Piece np = {rand()%7, 0, 0, 0, 0, 0, 0};
-    initQueuePiece(&np);
-
-    enqueue(&queue, np);
 
-    return -1;
-}
+#ifdef PROFILE
+    dumpProfile();
+    for (int p = 0; p < PHASE_COUNT; p++) {
+        if (overlay_lines[p])
+            SDL_DestroyTexture(overlay_lines[p]);
+    }
+#endif
 
-void drawLostDialog() {
+    destroyRender();
 
-    //draw box
-    int d_w = 300;
-    int d_h = 200;
-    SDL_Rect dialog_rect = {SCREEN_WIDTH/2 - d_w/2, SCREEN_HEIGHT/2 - d_h/2, d_w, d_h};
-    SDL_SetRenderDrawColor(renderer, 0x7F, 0x7F, 0x7F, 0xFF);
-    SDL_RenderFillRect(renderer, &dialog_rect);
+    if (autoplay)
+        destroyBot(&bot);
 
-    // draw text
-    int f_w, f_h;
-    TTF_SizeText(font, "GAME OVER", &f_w, &f_h);
-    SDL_Rect text_rect = {SCREEN_WIDTH/2 - f_w/2, SCREEN_HEIGHT/2 - f_h/2, f_w, f_h};
-    SDL_RenderCopy(renderer, text_cache[0], NULL, &text_rect);
+#ifdef PROFILE
+    TTF_Quit();
+#endif
+    SDL_DestroySemaphore(wake);
+    SDL_DestroyRenderer(renderer);
+    SDL_DestroyWindow(window);
 
+    SDL_Quit();
 }
 
-void printBoard() {
-    for (int m = 0; m < BOARD_HEIGHT; m++) {
-        SDL_Log("%02d %02d %02d %02d %02d %02d %02d %02d %02d %02d", board[0][m], board[1][m], board[2][m], board[3][m], board[4][m], board[5][m], board[6][m], board[7][m], board[8][m], board[9][m]);
-    }
-}
+void handleEvent(SDL_Event* e) {
+    if (e->type == SDL_QUIT) {
+        atomic_store(&running, 0);
+    } else if (e->type == frame_event) {
+        // only here to wake the loop
+    } else if (e->type == SDL_WINDOWEVENT) {
+        redraw = 1;
+    } else if (e->type == SDL_RENDER_TARGETS_RESET || e->type == SDL_RENDER_DEVICE_RESET) {
+        // the layers' contents are lost with the targets
+        invalidateLayers();
+        redraw = 1;
+#ifdef PROFILE
+    } else if (e->type == SDL_KEYDOWN && e->key.keysym.scancode == SDL_SCANCODE_F3) {
+        overlay = !overlay;
+        redraw = 1;
+#endif
+    } else if (e->type == SDL_KEYDOWN && e->key.keysym.scancode == SDL_SCANCODE_F5 && !versus) {
+        atomic_store(&command, COMMAND_SAVE);
+        SDL_SemPost(wake);
+    } else if (e->type == SDL_KEYDOWN && e->key.keysym.scancode == SDL_SCANCODE_F9 && !versus) {
+        atomic_store(&command, COMMAND_LOAD);
+        SDL_SemPost(wake);
+    } else if (e->type == SDL_KEYDOWN && !autoplay) {
+        enum Input input = INPUT_NONE;
+        switch (e->key.keysym.scancode) {
+            case SDL_SCANCODE_LEFT:
+                input = INPUT_LEFT;
+                break;
 
-void clearRows() {
-    int rows_cleared = 0;
-    for (int m = BOARD_HEIGHT-1; m >= 0; m--) {
-        char flag = 1;
-        for (int n = 0; n < BOARD_WIDTH; n++) {
-            if (board[n][m] == -1) {
-                flag = 0;
+            case SDL_SCANCODE_RIGHT:
+                input = INPUT_RIGHT;
                 break;
-            }
-        }
-        if (flag) {
-            SDL_Log("Clearing rows\n");
-            for (int p = m; p > 0; p--) {
-                for (int n = 0; n < BOARD_WIDTH; n++) {
-                    board[n][p] = board[n][p-1];
-                }
-            }
-        }
-    }
-}
 
-int rotate(struct Piece* piece) {
-    int x, y;
+            case SDL_SCANCODE_UP:
+                input = INPUT_ROTATE;
+                break;
 
-    struct Piece temp_piece;
-    memcpy(&temp_piece, piece, sizeof(struct Piece));
-    temp_piece.orientation = (temp_piece.orientation+1)%4;
+            case SDL_SCANCODE_DOWN:
+                input = INPUT_DROP;
+                break;
 
-    getRealCoords(&temp_piece, &x, &y);
-    int t_w = ((temp_piece.orientation & 1) ? temp_piece.w/SQUARE_SIZE : temp_piece.h/SQUARE_SIZE);
-    int t_h = ((temp_piece.orientation & 1) ? temp_piece.h/SQUARE_SIZE : temp_piece.w/SQUARE_SIZE);
-    SDL_Log("ROTATE");
-    /*
-    for (int n = 0; n < 4; n++) {
-        SDL_Log("%02d %02d %02d %02d", shape[0][n], shape[1][n],shape[2][n],shape[3][n]);
-    }
-    */
-    char l_shape[4][4];
-    memcpy(l_shape, shape, 4*4*sizeof(char));
-    rotateShape(&temp_piece, l_shape);
+            case SDL_SCANCODE_SPACE:
+                input = INPUT_HARD_DROP;
+                break;
+        }
 
-    for (int n = 0; n < 4; n++) {
-        SDL_Log("%02d %02d %02d %02d", l_shape[0][n], l_shape[1][n], l_shape[2][n], l_shape[3][n]);
+        // dropped if the ring is full
+        struct TimedInput timed = {input, e->key.timestamp};
+        if (input != INPUT_NONE && pushInputRing(&pending, timed) == 0)
+            SDL_SemPost(wake);
     }
+}
 
-    char flag;
-    for (int n = 0; n < t_w; n++) {
-        for (int m = 0; m < t_h; m++) {
-            if (l_shape[m][n] != -1 && board[x/SQUARE_SIZE+m][y/SQUARE_SIZE+n] != -1) {
-                return -1;
-            }
+// runs ticks as they come due and publishes a frame whenever the game has
+// changed, sleeping until the next tick that does something or a key press
+int simulate(void* data) {
+    // tick n is due at start + n/TICK_RATE seconds
+    Uint32 start = SDL_GetTicks();
+
+    while (atomic_load(&running)) {
+        if (!dirty) {
+            Uint64 wake_at = ticks_done;
+            if (!autoplay && !versus && sizeInputRing(&pending) == 0)
+                wake_at += ticksUntilDrop(&game) - 1;
+
+            Uint32 due = start + wake_at*1000/TICK_RATE;
+            Uint32 now = SDL_GetTicks();
+            int timeout = (Sint32)(due - now) > 0 ? due - now : 0;
+            // the remote inputs can't post to the semaphore, so poll for them
+            if (stalled)
+                timeout = 1;
+
+            if (!versus && game.state != GAME && sizeInputRing(&pending) == 0)
+                SDL_SemWait(wake);
+            else
+                SDL_SemWaitTimeout(wake, timeout);
         }
-    }
 
-    piece->orientation = (piece->orientation+1)%4;
+        runCommand();
 
-    piece->real_x = x;
-    piece->real_y = y;
+        Uint32 now = SDL_GetTicks();
+        Uint32 next = start + ticks_done*1000/TICK_RATE;
 
-    while (piece->real_y + ((piece->orientation & 1) ? piece->w : piece->h) > BOARD_Y + BOARD_HEIGHT*SQUARE_SIZE) {
-        piece->y -= SQUARE_SIZE;
-        piece->real_y -= SQUARE_SIZE;
-    }
+        // too far behind to catch up, let the missed time go
+        if ((Sint32)(now - next) > MAX_CATCH_UP*1000/TICK_RATE) {
+            start += now - next - MAX_CATCH_UP*1000/TICK_RATE;
+            next = start + ticks_done*1000/TICK_RATE;
+        }
 
-    while (piece->real_x + ((piece->orientation & 1) ? piece->h : piece->w) > BOARD_X + BOARD_WIDTH*SQUARE_SIZE) {
-        piece->x -= SQUARE_SIZE;
-        piece->real_x -= SQUARE_SIZE;
-    }
+        PROFILE_BEGIN(PHASE_TICKS);
+        while ((Sint32)(now - next) >= 0) {
+            if (versus) {
+                // waits for the remote player rather than dropping the tick
+                if (versusStep(next) < 0)
+                    break;
+            } else {
+                applyInputs(next);
+                if (autoplay)
+                    autoplayStep();
+                if (tick(&game))
+                    dirty = 1;
+            }
 
-    while (piece->real_x < 0) {
-        piece->x += SQUARE_SIZE;
-        piece->real_x += SQUARE_SIZE;
-    }
+            ticks_done++;
+            next = start + ticks_done*1000/TICK_RATE;
+        }
+        PROFILE_END(PHASE_TICKS);
 
-    rotateShape(piece, shape);
-}
+        if (versus) {
+            readRemote();
+            if (rollback.mispredicted != ROLLBACK_NONE) {
+                reconcileRollback(&rollback);
+                dirty = 1;
+            }
+        }
 
-int moveLeft(struct Piece* piece) {
-    if (piece->real_x - SQUARE_SIZE >= 0) {
-        piece->x -= SQUARE_SIZE;
-        piece->real_x -= SQUARE_SIZE;
+        if (dirty)
+            publish();
     }
+    return 0;
 }
 
-int moveRight(struct Piece* piece) {
-    if (piece->real_x + ((piece->orientation & 1) ? piece->h: piece->w) + SQUARE_SIZE <= BOARD_X + BOARD_WIDTH*SQUARE_SIZE) {
-        piece->x += SQUARE_SIZE;
-        piece->real_x += SQUARE_SIZE;
-    }
+// copies the game into the back frame and hands it to the render thread
+void publish() {
+    struct Frame* frame = backFrameBuffer(&frames);
+    if (versus) {
+        frame->players[0] = rollback.state.players[0];
+        frame->players[1] = rollback.state.players[1];
+        frame->player_count = 2;
+        frame->winner = versusWinner(&rollback.state);
+        frame->ticks = rollback.state.ticks;
+    } else {
+        frame->players[0] = game;
+        frame->player_count = 1;
+        frame->winner = -1;
+        frame->ticks = ticks_done;
+    }
+    frame->applied = applied;
+    frame->published = SDL_GetTicks();
+
+    // a frame that was never read already has its event waiting
+    if (publishFrameBuffer(&frames)) {
+        dropped_frames++;
+    } else {
+        SDL_Event e = {.type = frame_event};
+        SDL_PushEvent(&e);
+    }
+    dirty = 0;
 }
 
-void getRealCoords(struct Piece* piece, int* x, int* y) {
-    switch (piece->type) {
-        case I:
-            switch (piece->orientation) {
-                case 0:
-                    *x = piece->x;
-                    *y = piece->y;
-                    break;
-                case 1:
-                    *x = piece->x + SQUARE_SIZE;
-                    *y = piece->y - 2*SQUARE_SIZE;
-                    break;
-                case 2:
-                    *x = piece->x;
-                    *y = piece->y - SQUARE_SIZE;
-                    break;
-                case 3:
-                    *x = piece->x + 2*SQUARE_SIZE;
-                    *y = piece->y - 2*SQUARE_SIZE;
-                    break;
-            }
-            break;
-        
-        case O:
-            *x = piece->x;
-            *y = piece->y;
-            break;
-
-        case J:
-        case L:
-        case S:
-        case T:
-        case Z:
-
-            switch (piece->orientation) {
-                case 0:
-                    *x = piece->x;
-                    *y = piece->y;
-                    break;
-                case 1:
-                    *x = piece->x;
-                    *y = piece->y;
-                    break;
-                case 2:
-                    *x = piece->x - SQUARE_SIZE;
-                    *y = piece->y;
-                    break;
-                case 3:
-                    *x = piece->x;
-                    *y = piece->y - SQUARE_SIZE;
-                    break;
-            }
-
-    }
+void runCommand() {
+    int requested = atomic_exchange(&command, COMMAND_NONE);
+    if (requested == COMMAND_SAVE)
+        saveGame();
+    else if (requested == COMMAND_LOAD)
+        loadGame();
 }
 
-int initActivePiece(enum piece_type type, struct Piece* piece) {
-    memset(shape, -1, 16);
-    piece->type = type;
-    piece->orientation = 0;
-    piece->x = BOARD_X + (BOARD_WIDTH*SQUARE_SIZE)/2 - ((BOARD_WIDTH*SQUARE_SIZE)/2 % SQUARE_SIZE);
-    piece->y = BOARD_Y;
-    piece->real_x = piece->x;
-    piece->real_y = piece->y;
-
-    switch (type) {
-        case I:
-            {
-            piece->w = 4*SQUARE_SIZE;
-            piece->h = SQUARE_SIZE;
-
-            for (int n = 0; n < piece->w/SQUARE_SIZE; n++) {
-                for (int m = 0; m < piece->h/SQUARE_SIZE; m++) {
-                    shape[n][m] = i[n][m];
-                }
-            }
-
-            break;
-            }
-
-        case J:
-            piece->w = 3*SQUARE_SIZE;
-            piece->h = 2*SQUARE_SIZE;
-
-            for (int n = 0; n < piece->w/SQUARE_SIZE; n++) {
-                for (int m = 0; m < piece->h/SQUARE_SIZE; m++) {
-                    shape[n][m] = j[n][m];
-                }
-            }
-
-            break;
-
-        case L:
-            piece->w = 3*SQUARE_SIZE;
-            piece->h = 2*SQUARE_SIZE;
-
-            for (int n = 0; n < piece->w/SQUARE_SIZE; n++) {
-                for (int m = 0; m < piece->h/SQUARE_SIZE; m++) {
-                    shape[n][m] = l[n][m];
-                }
-            }
-
-            break;
-        case O:
-
-            piece->w = 2*SQUARE_SIZE;
-            piece->h = 2*SQUARE_SIZE;
-
-            for (int n = 0; n < piece->w/SQUARE_SIZE; n++) {
-                for (int m = 0; m < piece->h/SQUARE_SIZE; m++) {
-                    shape[n][m] = o[n][m];
-                }
-            }
-
-            break;
-
-        case S:
-            piece->w = 3*SQUARE_SIZE;
-            piece->h = 2*SQUARE_SIZE;
-
-            for (int n = 0; n < piece->w/SQUARE_SIZE; n++) {
-                for (int m = 0; m < piece->h/SQUARE_SIZE; m++) {
-                    shape[n][m] = s[n][m];
-                }
-            }
-            break;
+// steps the game and records the input on the current tick
+void play(enum Input input) {
+    if (game.state != GAME)
+        return;
 
-        case T:
-            piece->w = 3*SQUARE_SIZE;
-            piece->h = 2*SQUARE_SIZE;
-
-            for (int n = 0; n < piece->w/SQUARE_SIZE; n++) {
-                for (int m = 0; m < piece->h/SQUARE_SIZE; m++) {
-                    shape[n][m] = t[n][m];
-                }
-            }
-            break;
-
-        case Z:
-            piece->w = 3*SQUARE_SIZE;
-            piece->h = 2*SQUARE_SIZE;
-
-            for (int n = 0; n < piece->w/SQUARE_SIZE; n++) {
-                for (int m = 0; m < piece->h/SQUARE_SIZE; m++) {
-                    shape[n][m] = z[n][m];
-                }
-            }
-            break;
-        default:
-            piece->w = 3*SQUARE_SIZE;
-            piece->h = 2*SQUARE_SIZE;
+    step(&game, input);
+    if (recording && recordInput(&replay, ticks_done, input) < 0) {
+        SDL_Log("Couldn't write to the replay, no longer recording.\n");
+        recording = 0;
     }
-
-    for (int n = 0; n < 4; n++) {
-        SDL_Log("%02d %02d %02d %02d", shape[0][n], shape[1][n],shape[2][n],shape[3][n]);
-    }
-
 }
 
-int initQueuePiece(struct Piece* piece) {
-
-    switch (piece->type) {
-        case I:
-            {
-            piece->w = 4*SQUARE_SIZE;
-            piece->h = SQUARE_SIZE;
-            break;
-            }
-        case O:
-            {
-            piece->w = 2*SQUARE_SIZE;
-            piece->h = 2*SQUARE_SIZE;
-            break;
-            }
-        default:
-            piece->w = 3*SQUARE_SIZE;
-            piece->h = 2*SQUARE_SIZE;
+// steps the game with every input pressed by the tick at time
+void applyInputs(Uint32 time) {
+    struct TimedInput timed;
+    while (peekInputRing(&pending, 0, &timed) == 0 && (Sint32)(time - timed.time) >= 0) {
+        popInputRing(&pending, &timed);
+        play(timed.input);
+        if (pushTimeRing(&applied_times, timed.time) == 0)
+            applied++;
+        dirty = 1;
     }
 }
 
-int drawActivePiece(struct Piece* piece) {
-    int or = piece->orientation;
-    int r_x = (piece->w)/2 - (((piece->w)/2) % SQUARE_SIZE);
-    int r_y = (piece->h)/2 - (((piece->h)/2) % SQUARE_SIZE);
-    SDL_Point p = {r_x, r_y};
-    SDL_Rect rect = {piece->x, piece->y, piece->w, piece->h};
-    SDL_RenderCopyEx(renderer, textures[piece->type], NULL, &rect, or*90, &p, SDL_FLIP_NONE);
-
-    SDL_SetRenderDrawColor(renderer, 127, 127, 127, 127);
-    SDL_RenderDrawPoint(renderer, piece->real_x, piece->real_y);
+void saveGame() {
+    struct Snapshot snapshot;
+    saveSnapshot(&snapshot, &game);
+    if (writeSnapshot(SAVE_PATH, &snapshot) < 0)
+        SDL_Log("Couldn't save the game to %s.\n", SAVE_PATH);
 }
 
-void drawQueue() {
-    for (int n = 0; n < QUEUE_CAPACITY; n++) {
-        struct Piece* piece = &queue_array[(queue.front + n)%queue.capacity];
-        SDL_Rect rect = {QUEUE_X + SQUARE_SIZE, QUEUE_Y + SQUARE_SIZE*(4*n+1), piece->w, piece->h};
-        SDL_RenderCopy(renderer, textures[piece->type], NULL, &rect);
+// a replay can't follow the game to a saved one, so not while recording
+void loadGame() {
+    struct Snapshot snapshot;
+    if (recording) {
+        SDL_Log("Can't load a game while recording a replay.\n");
+        return;
     }
-    SDL_SetRenderDrawColor(renderer, 127, 127, 127, 127);
-    SDL_Rect rect = {QUEUE_X, QUEUE_Y, QUEUE_WIDTH*SQUARE_SIZE, QUEUE_HEIGHT*SQUARE_SIZE};
-    SDL_RenderDrawRect(renderer, &rect);
+    if (readSnapshot(SAVE_PATH, &snapshot) < 0) {
+        SDL_Log("Couldn't load a saved game from %s.\n", SAVE_PATH);
+        return;
+    }
+    loadSnapshot(&game, &snapshot);
+    path_length = path_pos = 0;
+    dirty = 1;
 }
 
-void drawBoard() {
-    for (int m = 0; m < BOARD_WIDTH; m++) {
-        for (int n = 0; n < BOARD_HEIGHT; n++) {
-            switch(board[m][n]) {
-                case I:
-                    {
-                        SDL_Rect src_rect = {0, 0, 16, 16};
-                        SDL_Rect dst_rect = {m*SQUARE_SIZE, n*SQUARE_SIZE, SQUARE_SIZE, SQUARE_SIZE};
-                        SDL_RenderCopy(renderer, textures[I], &src_rect, &dst_rect);
-                        break;
-                    }
-
-                case J:
-                    {
-                        SDL_Rect src_rect = {0, 0, 16, 16};
-                        SDL_Rect dst_rect = {m*SQUARE_SIZE, n*SQUARE_SIZE, SQUARE_SIZE, SQUARE_SIZE};
-                        SDL_RenderCopy(renderer, textures[J], &src_rect, &dst_rect);
-                        break;
-                    }
-
-                case L:
-                    {
-                        SDL_Rect src_rect = {0, 0, 16, 16};
-                        SDL_Rect dst_rect = {m*SQUARE_SIZE, n*SQUARE_SIZE, SQUARE_SIZE, SQUARE_SIZE};
-                        SDL_RenderCopy(renderer, textures[L], &src_rect, &dst_rect);
-                        break;
-                    }
-
-                case O:
-                    {
-                        SDL_Rect src_rect = {0, 0, 16, 16};
-                        SDL_Rect dst_rect = {m*SQUARE_SIZE, n*SQUARE_SIZE, SQUARE_SIZE, SQUARE_SIZE};
-                        SDL_RenderCopy(renderer, textures[O], &src_rect, &dst_rect);
-                        break;
-                    }
-
-                case S:
-                    {
-                        SDL_Rect src_rect = {16, 0, 32, 16};
-                        SDL_Rect dst_rect = {m*SQUARE_SIZE, n*SQUARE_SIZE, SQUARE_SIZE, SQUARE_SIZE};
-                        SDL_RenderCopy(renderer, textures[S], &src_rect, &dst_rect);
-                        break;
-                    }
-
-                case T:
-                    {
-                        SDL_Rect src_rect = {16, 0, 32, 16};
-                        SDL_Rect dst_rect = {m*SQUARE_SIZE, n*SQUARE_SIZE, SQUARE_SIZE, SQUARE_SIZE};
-                        SDL_RenderCopy(renderer, textures[T], &src_rect, &dst_rect);
-                        break;
-                    }
-
-                case Z:
-                    {
-                        SDL_Rect src_rect = {0, 0, 16, 16};
-                        SDL_Rect dst_rect = {m*SQUARE_SIZE, n*SQUARE_SIZE, SQUARE_SIZE, SQUARE_SIZE};
-                        SDL_RenderCopy(renderer, textures[Z], &src_rect, &dst_rect);
-                        break;
-                    }
-            }
+void autoplayStep() {
+    if (game.state != GAME)
+        return;
+
+    if (path_pos == path_length || game.hash != path_hash) {
+        PROFILE_SCOPE(PHASE_BOT);
+        struct Placement placement;
+        path_pos = 0;
+        path_length = 0;
+        if (botChoose(&bot, &game, &placement) == 0)
+            path_length = findPath(game.board, &game.active, &placement, path, MAX_PLACEMENTS);
+        if (path_length <= 0) {
+            path_length = 1;
+            path[0] = INPUT_HARD_DROP;
         }
     }
-    SDL_SetRenderDrawColor(renderer, 127, 127, 127, 127);
-    SDL_RenderDrawLine(renderer, 0, 0, 0, BOARD_HEIGHT*SQUARE_SIZE);
-    SDL_RenderDrawLine(renderer, 0, 0, BOARD_WIDTH*SQUARE_SIZE, 0);
-    SDL_RenderDrawLine(renderer, BOARD_WIDTH*SQUARE_SIZE, 0, BOARD_WIDTH*SQUARE_SIZE, BOARD_HEIGHT*SQUARE_SIZE);
-    SDL_RenderDrawLine(renderer, 0, BOARD_HEIGHT*SQUARE_SIZE, BOARD_WIDTH*SQUARE_SIZE, BOARD_HEIGHT*SQUARE_SIZE);
+    play(path[path_pos++]);
+    path_hash = game.hash;
+    dirty = 1;
 }
 
-SDL_Texture* loadImageTexture(char* path) {
-    SDL_Texture* texture = NULL;
-
-    SDL_Surface* loaded_surface = IMG_Load(path);
-
-    if (loaded_surface == NULL) {
-        SDL_Log("Couldn't load image at %s.\n", path);
-        SDL_Log("%s\n", IMG_GetError());
-        return texture;
+// reads whatever remote inputs have arrived, leaving any too far ahead to
+// take in the buffer for later
+void readRemote() {
+    ssize_t got = 0;
+    if (!remote_gone && remote_length < (int)sizeof(remote_lines) - 1) {
+        got = read(remote_fd, &remote_lines[remote_length], sizeof(remote_lines) - 1 - remote_length);
+        if (got == 0 || (got < 0 && errno != EAGAIN && errno != EINTR)) {
+            SDL_Log("The remote player is gone, they make no more moves.\n");
+            remote_gone = 1;
+        }
+        if (got > 0)
+            remote_length += got;
+    }
+    remote_lines[remote_length] = 0;
+
+    char* line = remote_lines;
+    char* end;
+    while ((end = strchr(line, '\n')) != NULL) {
+        unsigned long long at;
+        int input;
+        if (sscanf(line, "%llu %d", &at, &input) == 2 && input >= INPUT_NONE && input <= INPUT_HARD_DROP) {
+            int result = remoteInput(&rollback, at, input);
+            if (result > 0)
+                break;
+            if (result < 0)
+                SDL_Log("Ignoring remote input for tick %llu, it is out of order.\n", at);
+        }
+        line = end + 1;
     }
+    remote_length -= line - remote_lines;
+    memmove(remote_lines, line, remote_length);
+}
 
-    SDL_SetColorKey(loaded_surface, SDL_TRUE, SDL_MapRGB(loaded_surface->format, CK_RED, CK_GREEN, CK_BLUE));
-
-    texture = SDL_CreateTextureFromSurface(renderer, loaded_surface);
+// runs the next versus tick with the first input pressed by time, returns
+// -1 without running it if the remote player is too far behind
+int versusStep(Uint32 time) {
+    readRemote();
+    if (remote_gone)
+        remoteInput(&rollback, rollback.state.ticks, INPUT_NONE);
+
+    struct TimedInput timed;
+    enum Input local = INPUT_NONE;
+    int due = peekInputRing(&pending, 0, &timed) == 0 && (Sint32)(time - timed.time) >= 0;
+    if (due)
+        local = timed.input;
+    if (versusWinner(&rollback.state) >= 0)
+        local = INPUT_NONE;
+
+    stalled = advanceRollback(&rollback, local) < 0;
+    if (stalled)
+        return -1;
 
-    if (texture == NULL) {
-        SDL_Log("Couldn't convert image at %s to texture.\n", path);
+    if (due) {
+        popInputRing(&pending, &timed);
+        if (pushTimeRing(&applied_times, timed.time) == 0)
+            applied++;
     }
+    dirty = 1;
+    return 0;
+}
 
-    SDL_FreeSurface(loaded_surface);
+// how far towards the next row gravity has taken the piece, in pixels,
+// age ms after the frame. Only with -i, and only if it has room to fall.
+int fallOffset(const struct Game* player, Uint32 age) {
+    if (!interpolate || player->state != GAME || dropDistance(player) == 0)
+        return 0;
 
-    return texture;
+    double fraction = (player->gravity_ticks + age*TICK_RATE/1000.0)/gravityTicks(player->level);
+    return fraction < 1 ? fraction*SQUARE_SIZE : SQUARE_SIZE-1;
 }
 
-SDL_Texture* loadTextTexture(char* text, SDL_Color fg, SDL_Color bg) {
-    SDL_Surface* text_surface;
-    SDL_Texture* text_texture;
+// between locks only the rate and the active piece change, the rest is
+// copied from the layers
+void drawPlayer(const struct Game* player, Uint64 ticks, int fall) {
+    drawStack(player);
+    drawPanel(player);
+    drawRate(player, ticks);
+    if (player->state == GAME) {
+        drawGhost(player);
+        drawActivePiece(&player->active, fall);
+    }
+    flushSprites();
+}
 
-    if (!(text_surface = TTF_RenderText_Shaded(font, text, fg, bg))) {
-        SDL_Log("Failed to create surface: %s \n", SDL_GetError());
-        return NULL;
+void render(const struct Frame* frame) {
+    PROFILE_SCOPE(PHASE_RENDER);
+    SDL_RenderClear(renderer);
+
+    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
+    SDL_RenderFillRect(renderer, NULL);
+
+    Uint32 age = SDL_GetTicks() - frame->published;
+    for (int p = 0; p < frame->player_count; p++) {
+        setPlayer(p);
+        drawPlayer(&frame->players[p], frame->ticks, fallOffset(&frame->players[p], age));
+    }
+    setPlayer(0);
+
+    // a lost game is still drawn behind the dialog
+    const char* results[] = {"YOU WIN", "YOU LOSE", "DRAW"};
+    if (frame->player_count == 2 && frame->winner >= 0)
+        drawDialog(results[frame->winner], screen_width/2, SCREEN_HEIGHT/2);
+    else if (frame->player_count == 1 && frame->players[0].state == LOST)
+        drawDialog("GAME OVER", screen_width/2, SCREEN_HEIGHT/2);
+    flushSprites();
+
+#ifdef PROFILE
+    if (overlay)
+        drawOverlay();
+#endif
+
+    // with vsync this returns once the frame is on its way to the screen
+    PROFILE_BEGIN(PHASE_PRESENT);
+    SDL_RenderPresent(renderer);
+    PROFILE_END(PHASE_PRESENT);
+    redraw = 0;
+
+    if (!presented) {
+        presented = 1;
+        SDL_Log("first frame presented %.1f ms after start\n", (SDL_GetPerformanceCounter() - launched)*1e3/SDL_GetPerformanceFrequency());
+    }
+
+    // every press applied by the time of this frame is now on screen
+    Uint32 now = SDL_GetTicks();
+    Uint32 pressed;
+    while (shown < frame->applied && popTimeRing(&applied_times, &pressed) == 0) {
+        Uint32 latency = now - pressed;
+        latency_total += latency;
+        latency_count++;
+        if (latency > latency_max)
+            latency_max = latency;
+        shown++;
     }
+}
 
-    if (!(text_texture = SDL_CreateTextureFromSurface(renderer, text_surface))) {
-        SDL_Log("Failed to create texture from surface: %s\n", SDL_GetError());
-        return NULL;
+#ifdef PROFILE
+void drawOverlay() {
+    Uint32 now = SDL_GetTicks();
+    if (now - overlay_updated >= OVERLAY_REFRESH_MS) {
+        SDL_Color fg = {0xff, 0xff, 0xff};
+        SDL_Color bg = {0, 0, 0};
+        overlay_updated = now;
+
+        for (int p = 0; p < PHASE_COUNT; p++) {
+            char line[128];
+            snprintf(line, sizeof(line), "%s  p50 %.1f  p99 %.1f  max %.1f us", phase_names[p],
+                    phasePercentile(p, 0.5)/1e3, phasePercentile(p, 0.99)/1e3, phaseMax(p)/1e3);
+
+            if (overlay_lines[p])
+                SDL_DestroyTexture(overlay_lines[p]);
+            overlay_lines[p] = NULL;
+
+            SDL_Surface* surface = TTF_RenderText_Shaded(overlay_font, line, fg, bg);
+            if (surface) {
+                overlay_lines[p] = SDL_CreateTextureFromSurface(renderer, surface);
+                SDL_FreeSurface(surface);
+            }
+        }
     }
 
-    SDL_FreeSurface(text_surface);
-    return text_texture;
+    int y = OVERLAY_Y;
+    for (int p = 0; p < PHASE_COUNT; p++) {
+        if (!overlay_lines[p])
+            continue;
+
+        SDL_Rect rect = {OVERLAY_X, y, 0, 0};
+        SDL_QueryTexture(overlay_lines[p], NULL, NULL, &rect.w, &rect.h);
+        SDL_RenderCopy(renderer, overlay_lines[p], NULL, &rect);
+        y += rect.h;
+    }
 }
 
-int rotateShape(struct Piece* piece, char shp[4][4]) {
-    int t_w = (piece->orientation & 1) ? piece->h/SQUARE_SIZE : piece->w/SQUARE_SIZE;
-    int t_h = (piece->orientation & 1) ? piece->w/SQUARE_SIZE : piece->h/SQUARE_SIZE;
+void dumpProfile() {
+    char path[256];
+    char* formats[2] = {"csv", "json"};
 
-    for (int n = 0; n < 4; n++) {
-        for (int m = 0; m < n; m++) {
-            char temp = shp[n][m];
-            shp[n][m] = shp[m][n];
-            shp[m][n] = temp;
+    for (int n = 0; n < 2; n++) {
+        snprintf(path, sizeof(path), "%s.%s", profile_path, formats[n]);
+        FILE* file = fopen(path, "w");
+        if (file == NULL) {
+            SDL_Log("Couldn't write the profile to %s.\n", path);
+            continue;
         }
-    }
 
-    for (int n = 0; n < (t_w/2); n++) {
-        for (int m = 0; m < t_h; m++) {
-            char temp = shp[n][m];
-            shp[n][m] = shp[t_w-n-1][m];
-            shp[t_w-n-1][m] = temp;
-        }
+        int result = n == 0 ? dumpProfileCsv(file) : dumpProfileJson(file);
+        if (fclose(file) == EOF || result < 0)
+            SDL_Log("Couldn't write the profile to %s.\n", path);
     }
 }
+#endif
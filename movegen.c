@@ -0,0 +1,226 @@
+#include "movegen.h"
+#include <string.h>
+
+// bit x is set where the piece fits with its top left at (x, y)
+static row_t fitRow(const row_t* board, const struct Orientation* or, int y) {
+    row_t blocked = 0;
+
+    for (int m = 0; m < or->h; m++) {
+        for (unsigned cells = or->rows[m]; cells; cells &= cells-1)
+            blocked |= board[y+m] >> __builtin_ctz(cells);
+    }
+    return ~blocked & FULL_ROW >> (or->w - 1);
+}
+
+// moves every x in r by d, clamping to [0, max] like the kicks in rotate()
+static row_t shiftClamped(row_t r, int d, int max) {
+    row_t valid = FULL_ROW >> (BOARD_WIDTH-1 - max);
+    row_t out;
+
+    if (d >= 0) {
+        out = r << d;
+    } else {
+        out = r >> -d;
+        if (r & (ROW_BIT(-d) - 1))
+            out |= 1;
+    }
+
+    if (out & ~valid)
+        out = (out & valid) | ROW_BIT(max);
+    return out;
+}
+
+// grows r sideways through the runs of fit it touches
+static row_t spreadRow(row_t r, row_t fit) {
+    row_t left = fit, right = fit;
+
+    for (int d = 1; d < BOARD_WIDTH; d <<= 1) {
+        r |= ((r << d) & left) | ((r >> d) & right);
+        left &= left << d;
+        right &= right >> d;
+    }
+    return r;
+}
+
+static int sameShape(const struct Orientation* a, const struct Orientation* b) {
+    return a->w == b->w && a->h == b->h && !memcmp(a->rows, b->rows, sizeof(a->rows));
+}
+
+// fit has one row past the bottom so resting spots can look below themselves
+static void fitRows(const row_t* board, enum piece_type type, row_t fit[4][BOARD_HEIGHT+1]) {
+    const struct Orientation* ors = orientations[type];
+
+    for (int o = 0; o < 4; o++) {
+        for (int y = 0; y <= BOARD_HEIGHT; y++)
+            fit[o][y] = y <= BOARD_HEIGHT - ors[o].h ? fitRow(board, &ors[o], y) : 0;
+    }
+}
+
+int generatePlacements(const row_t* board, const struct Piece* piece, struct Placement* placements) {
+    const struct Orientation* ors = orientations[piece->type];
+    row_t fit[4][BOARD_HEIGHT+1];
+    row_t reach[4][BOARD_HEIGHT];
+    int count = 0;
+
+    fitRows(board, piece->type, fit);
+
+    if (!(fit[(int)piece->orientation][piece->y] & ROW_BIT(piece->x)))
+        return 0;
+
+    memset(reach, 0, sizeof(reach));
+    reach[(int)piece->orientation][piece->y] = spreadRow(ROW_BIT(piece->x), fit[(int)piece->orientation][piece->y]);
+
+    // flood each orientation sideways and down, then rotate every reached
+    // spot, until nothing new turns up. Rows in reach are always already
+    // spread sideways.
+    for (int changed = 1; changed;) {
+        changed = 0;
+
+        for (int o = 0; o < 4; o++) {
+            for (int y = 1; y < BOARD_HEIGHT; y++) {
+                row_t r = reach[o][y-1] & fit[o][y] & ~reach[o][y];
+                if (r) {
+                    reach[o][y] = spreadRow(reach[o][y] | r, fit[o][y]);
+                    changed = 1;
+                }
+            }
+        }
+
+        for (int o = 0; o < 4; o++) {
+            int next = (o+1)%4;
+            const struct Orientation* from = &ors[o];
+            const struct Orientation* to = &ors[next];
+
+            for (int y = 0; y < BOARD_HEIGHT; y++) {
+                if (!reach[o][y])
+                    continue;
+
+                int ny = y - from->dy + to->dy;
+                if (ny + to->h > BOARD_HEIGHT)
+                    ny = BOARD_HEIGHT - to->h;
+                if (ny < 0)
+                    ny = 0;
+
+                row_t r = shiftClamped(reach[o][y], to->dx - from->dx, BOARD_WIDTH - to->w) & fit[next][ny];
+                if (r & ~reach[next][ny]) {
+                    reach[next][ny] = spreadRow(reach[next][ny] | r, fit[next][ny]);
+                    changed = 1;
+                }
+            }
+        }
+    }
+
+    // orientations with the same cells give the same placement at the
+    // same spot, only report the first one reached
+    row_t seen[4][BOARD_HEIGHT];
+    memset(seen, 0, sizeof(seen));
+
+    for (int o = 0; o < 4; o++) {
+        int same = o;
+        for (int k = 0; k < o; k++) {
+            if (sameShape(&ors[k], &ors[o])) {
+                same = k;
+                break;
+            }
+        }
+
+        for (int y = 0; y < BOARD_HEIGHT; y++) {
+            row_t rest = reach[o][y] & ~fit[o][y+1] & ~seen[same][y];
+            seen[same][y] |= rest;
+
+            for (int x = 0; rest; x++, rest >>= 1) {
+                if (rest & 1) {
+                    placements[count].x = x;
+                    placements[count].y = y;
+                    placements[count].orientation = o;
+                    count++;
+                }
+            }
+        }
+    }
+
+    return count;
+}
+
+#define STATE(o, x, y) (((o)*BOARD_HEIGHT + (y))*BOARD_WIDTH + (x))
+
+int findPath(const row_t* board, const struct Piece* piece, const struct Placement* placement, enum Input* path, int max) {
+    const struct Orientation* ors = orientations[piece->type];
+    row_t fit[4][BOARD_HEIGHT+1];
+    short from[4*BOARD_HEIGHT*BOARD_WIDTH];
+    char input[4*BOARD_HEIGHT*BOARD_WIDTH];
+    short queue[4*BOARD_HEIGHT*BOARD_WIDTH];
+    int head = 0, tail = 0;
+
+    fitRows(board, piece->type, fit);
+    if (!(fit[(int)piece->orientation][piece->y] & ROW_BIT(piece->x)))
+        return -1;
+
+    memset(from, -1, sizeof(from));
+    int start = STATE(piece->orientation, piece->x, piece->y);
+    int goal = STATE(placement->orientation, placement->x, placement->y);
+    from[start] = start;
+    queue[tail++] = start;
+
+    // breadth first, so the path uses as few inputs as possible
+    while (head < tail && from[goal] < 0) {
+        int state = queue[head++];
+        int x = state % BOARD_WIDTH;
+        int y = state / BOARD_WIDTH % BOARD_HEIGHT;
+        int o = state / (BOARD_WIDTH*BOARD_HEIGHT);
+        int next[4][4] = {
+            {INPUT_LEFT, o, x-1, y},
+            {INPUT_RIGHT, o, x+1, y},
+            {INPUT_DROP, o, x, y+1},
+            {INPUT_ROTATE, (o+1)%4, 0, 0},
+        };
+
+        const struct Orientation* to = &ors[next[3][1]];
+        next[3][2] = x - ors[o].dx + to->dx;
+        next[3][3] = y - ors[o].dy + to->dy;
+        if (next[3][3] + to->h > BOARD_HEIGHT)
+            next[3][3] = BOARD_HEIGHT - to->h;
+        if (next[3][3] < 0)
+            next[3][3] = 0;
+        if (next[3][2] + to->w > BOARD_WIDTH)
+            next[3][2] = BOARD_WIDTH - to->w;
+        if (next[3][2] < 0)
+            next[3][2] = 0;
+
+        for (int n = 0; n < 4; n++) {
+            int no = next[n][1], nx = next[n][2], ny = next[n][3];
+            if (nx < 0 || nx >= BOARD_WIDTH || !(fit[no][ny] & ROW_BIT(nx)))
+                continue;
+
+            int s = STATE(no, nx, ny);
+            if (from[s] >= 0)
+                continue;
+            from[s] = state;
+            input[s] = next[n][0];
+            queue[tail++] = s;
+        }
+    }
+
+    if (from[goal] < 0)
+        return -1;
+
+    int length = 1;
+    for (int s = goal; s != start; s = from[s])
+        length++;
+
+    // trailing drops and the final locking drop become one hard drop
+    int end = goal;
+    while (end != start && input[end] == INPUT_DROP) {
+        end = from[end];
+        length--;
+    }
+
+    if (length > max)
+        return -1;
+
+    path[length-1] = INPUT_HARD_DROP;
+    int n = length-1;
+    for (int s = end; s != start; s = from[s])
+        path[--n] = input[s];
+    return length;
+}
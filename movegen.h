@@ -0,0 +1,24 @@
+#ifndef MOVEGEN_H
+#define MOVEGEN_H
+
+#include "engine.h"
+
+// a piece's final resting spot, x and y are the top left of its bounding box
+struct Placement {
+    char x, y, orientation;
+};
+
+#define MAX_PLACEMENTS (4*BOARD_WIDTH*BOARD_HEIGHT)
+// findPath numbers every spot in a short
+_Static_assert(MAX_PLACEMENTS <= 32767 && BOARD_HEIGHT <= 127, "the board is too big for placements");
+
+// fills placements, which must hold MAX_PLACEMENTS, with every distinct
+// spot the piece can lock in starting from where it is now, and returns
+// how many there are
+int generatePlacements(const row_t* board, const struct Piece* piece, struct Placement* placements);
+
+// fills path with the inputs that take the piece to placement and lock it
+// there, returns how many or -1 if it cannot get there
+int findPath(const row_t* board, const struct Piece* piece, const struct Placement* placement, enum Input* path, int max);
+
+#endif
@@ -0,0 +1,71 @@
+#include "pack.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// faults the pages in with the mmap call where that is supported
+#ifndef MAP_POPULATE
+#define MAP_POPULATE 0
+#endif
+
+static const char magic[4] = {'T', 'P', 'A', 'K'};
+
+int loadPack(struct Pack* pack, const char* path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return -1;
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(struct PackHeader)) {
+        close(fd);
+        return -1;
+    }
+
+    // the mapping stays valid once the file is closed
+    void* map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return -1;
+
+    const struct PackHeader* header = map;
+    size_t pixels = (size_t)header->width*header->height*4;
+    if (memcmp(header->magic, magic, sizeof(magic)) || header->version != PACK_VERSION
+            || st.st_size - sizeof(struct PackHeader) < pixels) {
+        munmap(map, st.st_size);
+        return -1;
+    }
+
+    pack->header = header;
+    pack->pixels = (const unsigned char*)map + sizeof(struct PackHeader);
+    pack->map = map;
+    pack->size = st.st_size;
+    return 0;
+}
+
+void freePack(struct Pack* pack) {
+    munmap(pack->map, pack->size);
+    pack->map = NULL;
+    pack->header = NULL;
+    pack->pixels = NULL;
+}
+
+int writePack(const char* path, const struct PackHeader* header, const unsigned char* pixels, int pitch) {
+    FILE* file = fopen(path, "wb");
+    if (file == NULL)
+        return -1;
+
+    struct PackHeader out = *header;
+    memcpy(out.magic, magic, sizeof(magic));
+    out.version = PACK_VERSION;
+
+    int failed = fwrite(&out, sizeof(out), 1, file) != 1;
+    for (uint32_t y = 0; y < out.height && !failed; y++)
+        failed = fwrite(pixels + (size_t)y*pitch, 4, out.width, file) != out.width;
+
+    if (fclose(file) == EOF || failed)
+        return -1;
+    return 0;
+}
@@ -0,0 +1,48 @@
+#ifndef PACK_H
+#define PACK_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// An asset pack is the sprite atlas ready to upload: this header as it is
+// laid out in memory, then width*height RGBA32 pixels. It is written and
+// read in native byte order by the packer and the game built alongside it,
+// and mapped in place rather than parsed.
+#define PACK_VERSION 1
+// printable ASCII, anything else is drawn as a space
+#define PACK_FIRST_GLYPH ' '
+#define PACK_LAST_GLYPH '~'
+#define PACK_GLYPHS (PACK_LAST_GLYPH - PACK_FIRST_GLYPH + 1)
+
+struct PackRect {
+    int32_t x, y, w, h;
+};
+
+struct PackGlyph {
+    struct PackRect rect;
+    int32_t advance;
+};
+
+struct PackHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t width, height;
+    // indexed by piece type
+    struct PackRect sprites[7];
+    int32_t glyph_height;
+    struct PackGlyph glyphs[PACK_GLYPHS];
+};
+
+struct Pack {
+    const struct PackHeader* header;
+    const unsigned char* pixels;
+    void* map;
+    size_t size;
+};
+
+int loadPack(struct Pack* pack, const char* path);
+void freePack(struct Pack* pack);
+// pitch is the bytes between rows of pixels
+int writePack(const char* path, const struct PackHeader* header, const unsigned char* pixels, int pitch);
+
+#endif
@@ -0,0 +1,168 @@
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_image.h>
+#include <SDL2/SDL_ttf.h>
+#include <stdio.h>
+
+#include "pack.h"
+#include "piece.h"
+
+#define CK_RED 0xFF
+#define CK_GREEN 0xFF
+#define CK_BLUE 0xFF
+
+// one sprite per row, the glyphs are packed in rows of GLYPH_SHEET_WIDTH below
+#define ATLAS_ROW 32
+#define GLYPH_SHEET_WIDTH 256
+#define FONT_SIZE 24
+
+static SDL_Surface* loadImageSurface(char* path) {
+    SDL_Surface* loaded_surface = IMG_Load(path);
+
+    if (loaded_surface == NULL) {
+        fprintf(stderr, "couldn't load image at %s: %s\n", path, IMG_GetError());
+        return NULL;
+    }
+
+    SDL_SetColorKey(loaded_surface, SDL_TRUE, SDL_MapRGB(loaded_surface->format, CK_RED, CK_GREEN, CK_BLUE));
+    return loaded_surface;
+}
+
+// renders every glyph white and lays them out in rows starting at top,
+// returning the height the rows take up. Glyphs with nothing to draw get
+// no surface.
+static int renderGlyphs(TTF_Font* font, SDL_Surface* surfaces[], int top, struct PackHeader* header) {
+    SDL_Color white = {0xff, 0xff, 0xff, 0xff};
+    int x = 0, y = top, row_h = 0;
+    header->glyph_height = TTF_FontHeight(font);
+
+    for (int n = 0; n < PACK_GLYPHS; n++) {
+        struct PackGlyph* glyph = &header->glyphs[n];
+        int min_x, max_x, min_y, max_y, advance;
+        if (TTF_GlyphMetrics(font, PACK_FIRST_GLYPH + n, &min_x, &max_x, &min_y, &max_y, &advance) < 0) {
+            fprintf(stderr, "couldn't get the metrics of '%c': %s\n", PACK_FIRST_GLYPH + n, TTF_GetError());
+            return -1;
+        }
+        glyph->advance = advance;
+        glyph->rect = (struct PackRect){0, 0, 0, 0};
+
+        if ((surfaces[n] = TTF_RenderGlyph_Blended(font, PACK_FIRST_GLYPH + n, white)) == NULL)
+            continue;
+
+        if (x + surfaces[n]->w > GLYPH_SHEET_WIDTH) {
+            x = 0;
+            y += row_h;
+            row_h = 0;
+        }
+        glyph->rect = (struct PackRect){x, y, surfaces[n]->w, surfaces[n]->h};
+        x += surfaces[n]->w;
+        if (surfaces[n]->h > row_h)
+            row_h = surfaces[n]->h;
+    }
+    return y + row_h - top;
+}
+
+// stacks the seven sprites into one RGBA32 surface with font's glyphs
+// below them, filling in the header's rects
+static SDL_Surface* buildAtlas(char* paths[7], TTF_Font* font, struct PackHeader* header) {
+    int w = GLYPH_SHEET_WIDTH;
+    int h = 7*ATLAS_ROW;
+
+    SDL_Surface* surfaces[7];
+    for (int n = 0; n < 7; n++) {
+        if ((surfaces[n] = loadImageSurface(paths[n])) == NULL) {
+            while (n--)
+                SDL_FreeSurface(surfaces[n]);
+            return NULL;
+        }
+        if (surfaces[n]->w > w)
+            w = surfaces[n]->w;
+    }
+
+    SDL_Surface* glyph_surfaces[PACK_GLYPHS] = {NULL};
+    int glyph_rows = renderGlyphs(font, glyph_surfaces, h, header);
+
+    // starts out transparent, the color keyed pixels are skipped by the blits
+    SDL_Surface* sheet = NULL;
+    if (glyph_rows >= 0)
+        sheet = SDL_CreateRGBSurfaceWithFormat(0, w, h + glyph_rows, 32, SDL_PIXELFORMAT_RGBA32);
+    if (sheet != NULL) {
+        SDL_FillRect(sheet, NULL, SDL_MapRGBA(sheet->format, 0, 0, 0, 0));
+        for (int n = 0; n < 7; n++) {
+            SDL_Rect rect = {0, n*ATLAS_ROW, surfaces[n]->w, surfaces[n]->h};
+            header->sprites[n] = (struct PackRect){rect.x, rect.y, rect.w, rect.h};
+            SDL_SetSurfaceBlendMode(surfaces[n], SDL_BLENDMODE_NONE);
+            SDL_BlitSurface(surfaces[n], NULL, sheet, &rect);
+        }
+        // the glyphs keep their alpha so they can be tinted by the vertex color
+        for (int n = 0; n < PACK_GLYPHS; n++) {
+            if (glyph_surfaces[n] == NULL)
+                continue;
+            struct PackRect* r = &header->glyphs[n].rect;
+            SDL_Rect rect = {r->x, r->y, r->w, r->h};
+            SDL_SetSurfaceBlendMode(glyph_surfaces[n], SDL_BLENDMODE_NONE);
+            SDL_BlitSurface(glyph_surfaces[n], NULL, sheet, &rect);
+        }
+        header->width = sheet->w;
+        header->height = sheet->h;
+    }
+
+    for (int n = 0; n < 7; n++)
+        SDL_FreeSurface(surfaces[n]);
+    for (int n = 0; n < PACK_GLYPHS; n++) {
+        if (glyph_surfaces[n])
+            SDL_FreeSurface(glyph_surfaces[n]);
+    }
+
+    if (sheet == NULL && glyph_rows >= 0)
+        fprintf(stderr, "couldn't create the sprite atlas: %s\n", SDL_GetError());
+    return sheet;
+}
+
+// bakes the sprites and the font's glyphs into an asset pack, so the game
+// doesn't decode PNGs or rasterize text when it starts
+int main(int argc, char* argv[]) {
+    char* path = argc > 1 ? argv[1] : "assets.pack";
+    int flags = IMG_INIT_PNG;
+
+    if ((IMG_Init(flags) & flags) != flags || TTF_Init() < 0) {
+        fprintf(stderr, "couldn't initialize SDL_image and SDL_ttf\n");
+        return 1;
+    }
+
+    TTF_Font* font = TTF_OpenFont("fonts/OpenSans-Regular.ttf", FONT_SIZE);
+    if (font == NULL) {
+        fprintf(stderr, "couldn't load font: %s\n", TTF_GetError());
+        return 1;
+    }
+
+    char* sprites[7];
+    sprites[I] = "img/i.png";
+    sprites[J] = "img/j.png";
+    sprites[L] = "img/l.png";
+    sprites[O] = "img/o.png";
+    sprites[S] = "img/s.png";
+    sprites[T] = "img/t.png";
+    sprites[Z] = "img/z.png";
+
+    struct PackHeader header = {0};
+    SDL_Surface* sheet = buildAtlas(sprites, font, &header);
+    TTF_CloseFont(font);
+    if (sheet == NULL)
+        return 1;
+
+    SDL_LockSurface(sheet);
+    int result = writePack(path, &header, sheet->pixels, sheet->pitch);
+    SDL_UnlockSurface(sheet);
+    SDL_FreeSurface(sheet);
+
+    if (result < 0) {
+        fprintf(stderr, "couldn't write %s\n", path);
+        return 1;
+    }
+    printf("%s: %ux%u atlas, %zu bytes\n", path, header.width, header.height,
+            sizeof(header) + (size_t)header.width*header.height*4);
+
+    TTF_Quit();
+    IMG_Quit();
+    return 0;
+}
@@ -0,0 +1,253 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "engine.h"
+#include "movegen.h"
+#include "pool.h"
+#include "ttable.h"
+
+// Counts every sequence of placements depth pieces long from a seeded game,
+// like perft counts move sequences in chess. Placements come from movegen
+// and are locked with the engine's own drop, so the counts change if the
+// rules for moving, rotating, locking or clearing rows do.
+
+#define MAX_DEPTH 16
+// subtrees this many placements down from the start are shared out to the
+// pool, a few hundred of them for the threads to balance
+#define SPLIT_DEPTH 2
+
+struct Perft {
+    struct Pool pool;
+    // remaining depth and position to nodes under it, NULL without -m
+    struct TTable* table;
+    // reach every placement with findPath and step too, and compare
+    int check;
+    atomic_long mismatches;
+};
+
+struct PerftTask {
+    struct Perft* perft;
+    struct Game game;
+    int depth;
+    long nodes;
+};
+
+static double now() {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec/1e9;
+}
+
+// locks the active piece at placement the way the game would, clearing rows
+// and dealing the next piece
+static void place(struct Game* game, const struct Placement* placement) {
+    game->active.x = placement->x;
+    game->active.y = placement->y;
+    game->active.orientation = placement->orientation;
+    drop(game);
+}
+
+// whether the inputs findPath gives end in the same game as placing directly
+static int samePath(const struct Game* game, const struct Placement* placement, const struct Game* placed) {
+    enum Input path[MAX_PLACEMENTS];
+    int length = findPath(game->board, &game->active, placement, path, MAX_PLACEMENTS);
+    if (length < 0)
+        return 0;
+
+    struct Game stepped = *game;
+    for (int n = 0; n < length; n++)
+        step(&stepped, path[n]);
+    return stepped.pieces == placed->pieces && stepped.hash == placed->hash && stepped.state == placed->state;
+}
+
+// Games that have locked the same number of pieces have dealt the same
+// pieces, so their randomizers match and the hash, which covers the board,
+// the active piece and the queue, is all that tells them apart. The same
+// board can come back pieces later with different pieces still to come,
+// and the table is kept from one depth to the next, so the pieces locked
+// are part of the key along with the depth left.
+static uint64_t tableKey(const struct Game* game, int depth) {
+    return game->hash ^ ((uint64_t)game->pieces << 8 | depth)*0x9e3779b97f4a7c15ull;
+}
+
+// games exactly depth placements on from game
+static long count(struct Perft* perft, const struct Game* game, int depth) {
+    if (depth == 0)
+        return 1;
+    if (game->state != GAME)
+        return 0;
+
+    uint64_t data;
+    if (perft->table && depth > 1 && probeTable(perft->table, tableKey(game, depth), &data))
+        return data - 1;
+
+    struct Placement placements[MAX_PLACEMENTS];
+    int placed = generatePlacements(game->board, &game->active, placements);
+
+    long nodes = 0;
+    if (depth == 1 && !perft->check) {
+        nodes = placed;
+    } else {
+        for (int n = 0; n < placed; n++) {
+            struct Game child = *game;
+            place(&child, &placements[n]);
+            if (perft->check && !samePath(game, &placements[n], &child))
+                atomic_fetch_add(&perft->mismatches, 1);
+            nodes += count(perft, &child, depth-1);
+        }
+    }
+
+    // stored as nodes+1 as the table takes 0 to mean empty
+    if (perft->table && depth > 1)
+        storeTable(perft->table, tableKey(game, depth), nodes + 1);
+    return nodes;
+}
+
+static void runTask(void* arg) {
+    struct PerftTask* task = arg;
+    task->nodes = count(task->perft, &task->game, task->depth);
+}
+
+// the games split placements on from game, appended to tasks
+static int collect(struct Perft* perft, const struct Game* game, int split, int depth, struct PerftTask** tasks, int* used, int* capacity) {
+    // a lost game has nothing under it
+    if (game->state != GAME)
+        return 0;
+
+    if (split == 0) {
+        if (*used == *capacity) {
+            *capacity = *capacity ? 2 * *capacity : 256;
+            struct PerftTask* grown = realloc(*tasks, *capacity*sizeof(struct PerftTask));
+            if (grown == NULL)
+                return -1;
+            *tasks = grown;
+        }
+        struct PerftTask* task = &(*tasks)[(*used)++];
+        task->perft = perft;
+        task->game = *game;
+        task->depth = depth;
+        task->nodes = 0;
+        return 0;
+    }
+
+    struct Placement placements[MAX_PLACEMENTS];
+    int placed = generatePlacements(game->board, &game->active, placements);
+    for (int n = 0; n < placed; n++) {
+        struct Game child = *game;
+        place(&child, &placements[n]);
+        if (perft->check && !samePath(game, &placements[n], &child))
+            atomic_fetch_add(&perft->mismatches, 1);
+        if (collect(perft, &child, split-1, depth, tasks, used, capacity) < 0)
+            return -1;
+    }
+    return 0;
+}
+
+// games depth placements on from the start, the top of the tree walked
+// here and the subtrees under it counted on the pool
+static long perftDepth(struct Perft* perft, const struct Game* game, int depth) {
+    int split = depth > SPLIT_DEPTH ? SPLIT_DEPTH : depth-1;
+    if (split <= 0)
+        return count(perft, game, depth);
+
+    struct PerftTask* tasks = NULL;
+    int tasks_count = 0, capacity = 0;
+    if (collect(perft, game, split, depth - split, &tasks, &tasks_count, &capacity) < 0) {
+        free(tasks);
+        return -1;
+    }
+
+    for (int n = 0; n < tasks_count; n++)
+        poolSubmit(&perft->pool, runTask, &tasks[n]);
+    poolWait(&perft->pool);
+
+    long nodes = 0;
+    for (int n = 0; n < tasks_count; n++)
+        nodes += tasks[n].nodes;
+    free(tasks);
+    return nodes;
+}
+
+int main(int argc, char* argv[]) {
+    int depth = 4;
+    uint64_t seed = 1;
+    int threads = cpuCount();
+    int table_bits = 0;
+    int positional = 0;
+    enum RandomizerMode mode = RANDOM_UNIFORM;
+    struct Perft perft = {.table = NULL, .check = 0};
+
+    for (int n = 1; n < argc; n++) {
+        if (!strcmp(argv[n], "-j") && n+1 < argc)
+            threads = atoi(argv[++n]);
+        else if (!strcmp(argv[n], "-m") && n+1 < argc)
+            table_bits = atoi(argv[++n]);
+        else if (!strcmp(argv[n], "-c"))
+            perft.check = 1;
+        else if (!strcmp(argv[n], "-b"))
+            mode = RANDOM_BAG;
+        else if (positional++ == 0)
+            depth = atoi(argv[n]);
+        else
+            seed = strtoull(argv[n], NULL, 10);
+    }
+
+    if (depth < 1 || depth > MAX_DEPTH || threads < 1 || threads > POOL_MAX_THREADS || table_bits < 0 || table_bits > 32) {
+        fprintf(stderr, "usage: %s [-j threads] [-m table bits] [-c] [-b] [depth] [seed]\n", argv[0]);
+        return 1;
+    }
+
+    struct TTable table;
+    if (table_bits > 0) {
+        if (initTable(&table, table_bits) < 0) {
+            fprintf(stderr, "Couldn't allocate the table\n");
+            return 1;
+        }
+        perft.table = &table;
+    }
+    if (initPool(&perft.pool, threads) < 0) {
+        fprintf(stderr, "Couldn't start the pool\n");
+        return 1;
+    }
+    atomic_init(&perft.mismatches, 0);
+
+    struct Game game;
+    initGame(&game, seed, mode);
+
+    printf("seed: %llu\n", (unsigned long long)seed);
+    long total = 0;
+    double start = now();
+
+    // each depth is counted from scratch, as chess perft does
+    for (int d = 1; d <= depth; d++) {
+        double from = now();
+        long nodes = perftDepth(&perft, &game, d);
+        if (nodes < 0) {
+            fprintf(stderr, "Out of memory at depth %d\n", d);
+            return 1;
+        }
+        double secs = now() - from;
+
+        printf("depth %d: %ld nodes, %.3f s, %.0f nodes/sec\n", d, nodes, secs, secs > 0 ? nodes/secs : 0);
+        total += nodes;
+    }
+
+    double secs = now() - start;
+    printf("nodes: %ld\n", total);
+    printf("nodes/sec: %.0f\n", secs > 0 ? total/secs : 0);
+    if (perft.table) {
+        struct TableStats stats;
+        tableStats(&table, &stats);
+        printf("table probes: %ld\n", stats.probes);
+        printf("table hit rate: %.1f%%\n", stats.probes ? 100.0*stats.hits/stats.probes : 0);
+    }
+    if (perft.check)
+        printf("path mismatches: %ld\n", atomic_load(&perft.mismatches));
+
+    destroyPool(&perft.pool);
+    if (perft.table)
+        destroyTable(&table);
+    return perft.check && atomic_load(&perft.mismatches) ? 1 : 0;
+}
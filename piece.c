@@ -0,0 +1,53 @@
+#include "piece.h"
+
+const struct Orientation orientations[7][4] = {
+    // I
+    {
+        {{0xf, 0x0, 0x0, 0x0}, 4, 1, 0, 0, {0, 0, 0, 0}},
+        {{0x1, 0x1, 0x1, 0x1}, 1, 4, 1, -2, {3, 0, 0, 0}},
+        {{0xf, 0x0, 0x0, 0x0}, 4, 1, 0, -1, {0, 0, 0, 0}},
+        {{0x1, 0x1, 0x1, 0x1}, 1, 4, 2, -2, {3, 0, 0, 0}},
+    },
+    // J
+    {
+        {{0x7, 0x4, 0x0, 0x0}, 3, 2, 0, 0, {0, 0, 1, 0}},
+        {{0x2, 0x2, 0x3, 0x0}, 2, 3, 0, 0, {2, 2, 0, 0}},
+        {{0x1, 0x7, 0x0, 0x0}, 3, 2, -1, 0, {1, 1, 1, 0}},
+        {{0x3, 0x1, 0x1, 0x0}, 2, 3, 0, -1, {2, 0, 0, 0}},
+    },
+    // L
+    {
+        {{0x7, 0x1, 0x0, 0x0}, 3, 2, 0, 0, {1, 0, 0, 0}},
+        {{0x3, 0x2, 0x2, 0x0}, 2, 3, 0, 0, {0, 2, 0, 0}},
+        {{0x4, 0x7, 0x0, 0x0}, 3, 2, -1, 0, {1, 1, 1, 0}},
+        {{0x1, 0x1, 0x3, 0x0}, 2, 3, 0, -1, {2, 2, 0, 0}},
+    },
+    // O
+    {
+        {{0x3, 0x3, 0x0, 0x0}, 2, 2, 0, 0, {1, 1, 0, 0}},
+        {{0x3, 0x3, 0x0, 0x0}, 2, 2, 0, 0, {1, 1, 0, 0}},
+        {{0x3, 0x3, 0x0, 0x0}, 2, 2, 0, 0, {1, 1, 0, 0}},
+        {{0x3, 0x3, 0x0, 0x0}, 2, 2, 0, 0, {1, 1, 0, 0}},
+    },
+    // S
+    {
+        {{0x6, 0x3, 0x0, 0x0}, 3, 2, 0, 0, {1, 1, 0, 0}},
+        {{0x1, 0x3, 0x2, 0x0}, 2, 3, 0, 0, {1, 2, 0, 0}},
+        {{0x6, 0x3, 0x0, 0x0}, 3, 2, -1, 0, {1, 1, 0, 0}},
+        {{0x1, 0x3, 0x2, 0x0}, 2, 3, 0, -1, {1, 2, 0, 0}},
+    },
+    // T
+    {
+        {{0x7, 0x2, 0x0, 0x0}, 3, 2, 0, 0, {0, 1, 0, 0}},
+        {{0x2, 0x3, 0x2, 0x0}, 2, 3, 0, 0, {1, 2, 0, 0}},
+        {{0x2, 0x7, 0x0, 0x0}, 3, 2, -1, 0, {1, 1, 1, 0}},
+        {{0x1, 0x3, 0x1, 0x0}, 2, 3, 0, -1, {2, 1, 0, 0}},
+    },
+    // Z
+    {
+        {{0x3, 0x6, 0x0, 0x0}, 3, 2, 0, 0, {0, 1, 1, 0}},
+        {{0x2, 0x3, 0x1, 0x0}, 2, 3, 0, 0, {2, 1, 0, 0}},
+        {{0x3, 0x6, 0x0, 0x0}, 3, 2, -1, 0, {0, 1, 1, 0}},
+        {{0x2, 0x3, 0x1, 0x0}, 2, 3, 0, -1, {2, 1, 0, 0}},
+    },
+};
@@ -3,11 +3,25 @@
 
 enum piece_type {I, J, L, O, S, T, Z};
 
+// x and y are the top left of the piece's bounding box, in board cells
 struct Piece {
     enum piece_type type;
     char orientation;
-    int x, y, w, h;
-    int real_x, real_y;
+    int x, y;
 };
 
+struct Orientation {
+    // cells of each row, bit n is column n of the bounding box
+    unsigned char rows[4];
+    char w, h;
+    // offset from the unrotated piece's top left, the sprite is rotated
+    // around a fixed point so the bounding box moves with it
+    char dx, dy;
+    // row of the lowest cell in each column, what the piece lands on
+    char skirt[4];
+};
+
+// every orientation of every piece, clockwise from spawn
+extern const struct Orientation orientations[7][4];
+
 #endif
@@ -0,0 +1,163 @@
+#include "pool.h"
+#include <stdlib.h>
+#include <unistd.h>
+
+// the pool this thread is a worker of and its index there, NULL and -1 on
+// any other thread
+static __thread struct Pool* worker_pool = NULL;
+static __thread int worker_id = -1;
+
+static int pushTask(struct Deque* deque, struct Task task) {
+    int ok = 0;
+    pthread_mutex_lock(&deque->lock);
+    if (deque->bottom - deque->top < DEQUE_SIZE) {
+        deque->tasks[deque->bottom % DEQUE_SIZE] = task;
+        deque->bottom++;
+        ok = 1;
+    }
+    pthread_mutex_unlock(&deque->lock);
+    return ok;
+}
+
+static int popTask(struct Deque* deque, struct Task* task) {
+    int ok = 0;
+    pthread_mutex_lock(&deque->lock);
+    if (deque->bottom != deque->top) {
+        deque->bottom--;
+        *task = deque->tasks[deque->bottom % DEQUE_SIZE];
+        ok = 1;
+    }
+    pthread_mutex_unlock(&deque->lock);
+    return ok;
+}
+
+static int stealTask(struct Deque* deque, struct Task* task) {
+    int ok = 0;
+    if (pthread_mutex_trylock(&deque->lock) != 0)
+        return 0;
+    if (deque->bottom != deque->top) {
+        *task = deque->tasks[deque->top % DEQUE_SIZE];
+        deque->top++;
+        ok = 1;
+    }
+    pthread_mutex_unlock(&deque->lock);
+    return ok;
+}
+
+static void finishTask(struct Pool* pool) {
+    if (atomic_fetch_sub(&pool->pending, 1) == 1) {
+        pthread_mutex_lock(&pool->lock);
+        pthread_cond_broadcast(&pool->done);
+        pthread_mutex_unlock(&pool->lock);
+    }
+}
+
+static void* runWorker(void* arg) {
+    struct Worker* worker = arg;
+    struct Pool* pool = worker->pool;
+    int id = worker->id;
+    struct Task task;
+
+    worker_pool = pool;
+    worker_id = id;
+
+    while (!atomic_load(&pool->stop)) {
+        int found = popTask(&pool->deques[id], &task);
+        for (int n = 1; !found && n < pool->threads; n++)
+            found = stealTask(&pool->deques[(id + n) % pool->threads], &task);
+
+        if (found) {
+            atomic_fetch_sub(&pool->queued, 1);
+            task.fn(task.arg);
+            finishTask(pool);
+            continue;
+        }
+
+        pthread_mutex_lock(&pool->lock);
+        while (!atomic_load(&pool->stop) && atomic_load(&pool->queued) == 0)
+            pthread_cond_wait(&pool->work, &pool->lock);
+        pthread_mutex_unlock(&pool->lock);
+    }
+    return NULL;
+}
+
+int initPool(struct Pool* pool, int threads) {
+    if (threads < 1)
+        threads = 1;
+    if (threads > POOL_MAX_THREADS)
+        threads = POOL_MAX_THREADS;
+
+    pool->threads = threads;
+    atomic_init(&pool->pending, 0);
+    atomic_init(&pool->queued, 0);
+    atomic_init(&pool->stop, 0);
+    atomic_init(&pool->next, 0);
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work, NULL);
+    pthread_cond_init(&pool->done, NULL);
+
+    for (int n = 0; n < threads; n++) {
+        pthread_mutex_init(&pool->deques[n].lock, NULL);
+        pool->deques[n].top = 0;
+        pool->deques[n].bottom = 0;
+    }
+
+    for (int n = 0; n < threads; n++) {
+        pool->worker_args[n].pool = pool;
+        pool->worker_args[n].id = n;
+        if (pthread_create(&pool->workers[n], NULL, runWorker, &pool->worker_args[n]) != 0) {
+            pool->threads = n;
+            destroyPool(pool);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+void destroyPool(struct Pool* pool) {
+    pthread_mutex_lock(&pool->lock);
+    atomic_store(&pool->stop, 1);
+    pthread_cond_broadcast(&pool->work);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (int n = 0; n < pool->threads; n++)
+        pthread_join(pool->workers[n], NULL);
+    for (int n = 0; n < pool->threads; n++)
+        pthread_mutex_destroy(&pool->deques[n].lock);
+
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->work);
+    pthread_cond_destroy(&pool->done);
+}
+
+void poolSubmit(struct Pool* pool, void (*fn)(void*), void* arg) {
+    struct Task task = {fn, arg};
+    // tasks spawned by one of this pool's workers stay on its own deque,
+    // anywhere else they are dealt out in turn
+    int id = worker_pool == pool ? worker_id : (int)(atomic_fetch_add(&pool->next, 1) % pool->threads);
+
+    atomic_fetch_add(&pool->pending, 1);
+    atomic_fetch_add(&pool->queued, 1);
+    if (!pushTask(&pool->deques[id], task)) {
+        atomic_fetch_sub(&pool->queued, 1);
+        fn(arg);
+        finishTask(pool);
+        return;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pthread_cond_signal(&pool->work);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void poolWait(struct Pool* pool) {
+    pthread_mutex_lock(&pool->lock);
+    while (atomic_load(&pool->pending) > 0)
+        pthread_cond_wait(&pool->done, &pool->lock);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+int cpuCount() {
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? n : 1;
+}
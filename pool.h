@@ -0,0 +1,53 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+
+#define POOL_MAX_THREADS 64
+#define DEQUE_SIZE 1024
+
+struct Task {
+    void (*fn)(void* arg);
+    void* arg;
+};
+
+// the owning worker pushes and pops at the bottom, idle workers steal
+// from the top
+struct Deque {
+    pthread_mutex_t lock;
+    unsigned top, bottom;
+    struct Task tasks[DEQUE_SIZE];
+};
+
+struct Pool;
+
+struct Worker {
+    struct Pool* pool;
+    int id;
+};
+
+struct Pool {
+    int threads;
+    pthread_t workers[POOL_MAX_THREADS];
+    struct Worker worker_args[POOL_MAX_THREADS];
+    struct Deque deques[POOL_MAX_THREADS];
+
+    // submitted but not finished, and sitting in a deque
+    atomic_int pending;
+    atomic_int queued;
+    atomic_int stop;
+    atomic_uint next;
+
+    pthread_mutex_t lock;
+    pthread_cond_t work;
+    pthread_cond_t done;
+};
+
+int initPool(struct Pool* pool, int threads);
+void destroyPool(struct Pool* pool);
+void poolSubmit(struct Pool* pool, void (*fn)(void*), void* arg);
+void poolWait(struct Pool* pool);
+int cpuCount();
+
+#endif
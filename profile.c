@@ -0,0 +1,142 @@
+#include "profile.h"
+
+#ifdef PROFILE
+
+#include <string.h>
+#include <time.h>
+
+struct Histogram histograms[PHASE_COUNT];
+
+const char* phase_names[PHASE_COUNT] = {
+    [PHASE_EVENTS] = "events",
+    [PHASE_TICKS] = "ticks",
+    [PHASE_BOT] = "bot",
+    [PHASE_DROP] = "drop",
+    [PHASE_ROTATE] = "rotate",
+    [PHASE_CLEAR_ROWS] = "clearRows",
+    [PHASE_RENDER] = "render",
+    [PHASE_DRAW_QUEUE] = "drawQueue",
+    [PHASE_DRAW_BOARD] = "drawBoard",
+    [PHASE_DRAW_ACTIVE] = "drawActivePiece",
+    [PHASE_FLUSH] = "flushSprites",
+    [PHASE_PRESENT] = "present",
+};
+
+// where the clocks stood at startup, to work out the tick rate from later
+static uint64_t start_ticks;
+static uint64_t start_ns;
+
+static uint64_t nsNow() {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec*1000000000ull + t.tv_nsec;
+}
+
+__attribute__((constructor)) static void startClocks() {
+    start_ticks = profileNow();
+    start_ns = nsNow();
+}
+
+double ticksToNs(uint64_t ticks) {
+    uint64_t elapsed = profileNow() - start_ticks;
+    return elapsed ? (double)ticks*(nsNow() - start_ns)/elapsed : ticks;
+}
+
+static int bucketOf(uint64_t ticks) {
+    if (ticks < HISTOGRAM_LINEAR)
+        return ticks;
+
+    int bit = 63 - __builtin_clzll(ticks);
+    if (bit >= HISTOGRAM_MAX_BIT)
+        return HISTOGRAM_BUCKETS-1;
+    // the four bits under the top one pick the bucket within the power of two
+    return HISTOGRAM_LINEAR + (bit-4)*16 + ((ticks >> (bit-4)) & 15);
+}
+
+static uint64_t bucketLow(int bucket) {
+    if (bucket < HISTOGRAM_LINEAR)
+        return bucket;
+
+    int bit = (bucket - HISTOGRAM_LINEAR)/16 + 4;
+    return (uint64_t)(16 + (bucket - HISTOGRAM_LINEAR)%16) << (bit-4);
+}
+
+static uint64_t bucketHigh(int bucket) {
+    return bucket == HISTOGRAM_BUCKETS-1 ? UINT64_MAX : bucketLow(bucket+1) - 1;
+}
+
+void recordPhase(enum Phase phase, uint64_t ticks) {
+    struct Histogram* histogram = &histograms[phase];
+    histogram->buckets[bucketOf(ticks)]++;
+    histogram->count++;
+    histogram->total += ticks;
+    if (ticks > histogram->max)
+        histogram->max = ticks;
+}
+
+uint64_t phasePercentile(enum Phase phase, double fraction) {
+    struct Histogram* histogram = &histograms[phase];
+    uint64_t target = fraction*histogram->count;
+    uint64_t seen = 0;
+
+    for (int n = 0; n < HISTOGRAM_BUCKETS; n++) {
+        seen += histogram->buckets[n];
+        // the middle of the bucket, but never past the largest time seen
+        if (seen > target) {
+            uint64_t middle = bucketLow(n) + (bucketHigh(n) - bucketLow(n))/2;
+            return ticksToNs(middle < histogram->max ? middle : histogram->max);
+        }
+    }
+    return ticksToNs(histogram->max);
+}
+
+uint64_t phaseMax(enum Phase phase) {
+    return ticksToNs(histograms[phase].max);
+}
+
+uint64_t phaseMean(enum Phase phase) {
+    struct Histogram* histogram = &histograms[phase];
+    return histogram->count ? ticksToNs(histogram->total)/histogram->count : 0;
+}
+
+void resetProfile() {
+    memset(histograms, 0, sizeof(histograms));
+}
+
+// one row per phase and non-empty bucket
+int dumpProfileCsv(FILE* file) {
+    fprintf(file, "phase,low_ns,high_ns,count\n");
+    for (int p = 0; p < PHASE_COUNT; p++) {
+        for (int n = 0; n < HISTOGRAM_BUCKETS; n++) {
+            if (histograms[p].buckets[n])
+                fprintf(file, "%s,%.0f,%.0f,%u\n", phase_names[p], ticksToNs(bucketLow(n)),
+                        ticksToNs(bucketHigh(n)), histograms[p].buckets[n]);
+        }
+    }
+    return ferror(file) ? -1 : 0;
+}
+
+// a summary per phase followed by its non-empty buckets as [low_ns, count]
+int dumpProfileJson(FILE* file) {
+    fprintf(file, "{\n");
+    for (int p = 0; p < PHASE_COUNT; p++) {
+        struct Histogram* histogram = &histograms[p];
+        fprintf(file, "  \"%s\": {\"count\": %llu, \"mean_ns\": %llu, \"p50_ns\": %llu, \"p99_ns\": %llu, \"max_ns\": %llu, \"buckets\": [",
+                phase_names[p], (unsigned long long)histogram->count, (unsigned long long)phaseMean(p),
+                (unsigned long long)phasePercentile(p, 0.5), (unsigned long long)phasePercentile(p, 0.99),
+                (unsigned long long)phaseMax(p));
+
+        const char* separator = "";
+        for (int n = 0; n < HISTOGRAM_BUCKETS; n++) {
+            if (histogram->buckets[n]) {
+                fprintf(file, "%s[%.0f, %u]", separator, ticksToNs(bucketLow(n)), histogram->buckets[n]);
+                separator = ", ";
+            }
+        }
+        fprintf(file, "]}%s\n", p+1 < PHASE_COUNT ? "," : "");
+    }
+    fprintf(file, "}\n");
+    return ferror(file) ? -1 : 0;
+}
+
+#endif
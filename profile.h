@@ -0,0 +1,100 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+// Building with -DPROFILE times each phase into a histogram. Without it
+// the macros below are empty and nothing here is compiled in.
+
+enum Phase {
+    PHASE_EVENTS,
+    PHASE_TICKS,
+    PHASE_BOT,
+    PHASE_DROP,
+    PHASE_ROTATE,
+    PHASE_CLEAR_ROWS,
+    PHASE_RENDER,
+    PHASE_DRAW_QUEUE,
+    PHASE_DRAW_BOARD,
+    PHASE_DRAW_ACTIVE,
+    PHASE_FLUSH,
+    PHASE_PRESENT,
+    PHASE_COUNT
+};
+
+#ifdef PROFILE
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <time.h>
+#endif
+
+// Histograms count clock ticks, the TSC on x86 since reading it costs half
+// what clock_gettime does, and only turn them into ns when reporting.
+// Times under 16 ticks get a bucket each, longer ones 16 buckets per power
+// of two so every bucket is within 1/16 of its value. Past 2^36 ticks
+// everything lands in the last bucket.
+#define HISTOGRAM_LINEAR 16
+#define HISTOGRAM_MAX_BIT 36
+#define HISTOGRAM_BUCKETS (HISTOGRAM_LINEAR + (HISTOGRAM_MAX_BIT - 4)*16 + 1)
+
+struct Histogram {
+    uint32_t buckets[HISTOGRAM_BUCKETS];
+    uint64_t count;
+    uint64_t total;
+    uint64_t max;
+};
+
+// not locked, each phase must only be timed from one thread
+extern struct Histogram histograms[PHASE_COUNT];
+extern const char* phase_names[PHASE_COUNT];
+
+static inline uint64_t profileNow() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec*1000000000ull + t.tv_nsec;
+#endif
+}
+
+void recordPhase(enum Phase phase, uint64_t ticks);
+// ns for ticks of profileNow, measured over the time since startup
+double ticksToNs(uint64_t ticks);
+// the time in ns below which fraction of the samples fall, to within a bucket
+uint64_t phasePercentile(enum Phase phase, double fraction);
+uint64_t phaseMax(enum Phase phase);
+uint64_t phaseMean(enum Phase phase);
+void resetProfile();
+
+int dumpProfileCsv(FILE* file);
+int dumpProfileJson(FILE* file);
+
+struct ProfileScope {
+    enum Phase phase;
+    uint64_t start;
+};
+
+static inline void endProfileScope(struct ProfileScope* scope) {
+    recordPhase(scope->phase, profileNow() - scope->start);
+}
+
+// times from here to the end of the enclosing block, however it is left
+#define PROFILE_SCOPE(phase) \
+    struct ProfileScope profile_scope __attribute__((cleanup(endProfileScope))) = {phase, profileNow()}
+// times a stretch of code within one block
+#define PROFILE_BEGIN(phase) uint64_t profile_start_##phase = profileNow()
+#define PROFILE_END(phase) recordPhase(phase, profileNow() - profile_start_##phase)
+
+#else
+
+#define PROFILE_SCOPE(phase)
+#define PROFILE_BEGIN(phase)
+#define PROFILE_END(phase)
+
+#endif
+
+#endif
@@ -0,0 +1,61 @@
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include <stdint.h>
+
+#include "engine.h"
+
+// The server and its clients share a machine, so messages are the structs
+// below in native byte order with no framing beyond the leading byte.
+//
+// Each connection plays one game. A client sends single byte requests:
+// an enum Input (1 to 5) to step the game, MSG_TICK to advance it a tick,
+// MSG_STATE for the whole board, or MSG_NEW followed by a 64 bit seed and a
+// randomizer mode byte to start over. Inputs and ticks are answered with a
+// struct MoveReply, MSG_STATE and MSG_NEW with a struct StateReply, in the
+// order they were sent. Any number of requests can be sent at once, the
+// replies to everything read together come back in one write.
+#define MSG_TICK 6
+#define MSG_STATE 7
+#define MSG_NEW 8
+#define MSG_NEW_SIZE 10
+
+#define REPLY_MOVE 1
+#define REPLY_STATE 2
+
+struct MoveReply {
+    uint8_t kind;
+    // what step or tick returned
+    int8_t result;
+    uint8_t state;
+    uint8_t piece;
+    int8_t x, y;
+    uint8_t orientation;
+    // rows cleared by the last lock
+    uint8_t cleared;
+    uint32_t score;
+    uint32_t lines;
+    uint64_t hash;
+};
+
+struct StateReply {
+    uint8_t kind;
+    uint8_t state;
+    uint8_t piece;
+    int8_t x, y;
+    uint8_t orientation;
+    uint8_t queue[QUEUE_CAPACITY];
+    uint8_t level;
+    uint8_t reserved[6];
+    uint64_t hash;
+    uint32_t score;
+    uint32_t lines;
+    uint16_t board[BOARD_HEIGHT];
+};
+
+_Static_assert(sizeof(struct MoveReply) == 24, "MoveReply has padding");
+_Static_assert(sizeof(struct StateReply) == 32 + 2*BOARD_HEIGHT, "StateReply has padding");
+_Static_assert(QUEUE_CAPACITY == 3, "the queue doesn't fit the state reply");
+_Static_assert(BOARD_WIDTH <= 16, "rows don't fit the state reply");
+
+#endif
@@ -0,0 +1,388 @@
+#include <stdio.h>
+
+#include "profile.h"
+#include "render.h"
+
+SDL_Renderer* renderer;
+
+// the piece sprites and the glyphs, from the asset pack
+static SDL_Texture* atlas;
+static SDL_Rect atlas_rects[7];
+static int atlas_w, atlas_h;
+
+struct Glyph {
+    SDL_Rect rect;
+    int advance;
+};
+static struct Glyph glyphs[PACK_GLYPHS];
+static int glyph_height;
+
+// quads queued up by the draw functions and sent in one call by flushSprites
+#define MAX_TEXT 128
+#define MAX_SPRITES (BOARD_WIDTH*BOARD_HEIGHT + QUEUE_CAPACITY + 1 + MAX_TEXT)
+static SDL_Vertex vertices[4*MAX_SPRITES];
+static int indices[6*MAX_SPRITES];
+static int sprite_count = 0;
+
+// added to everything drawn, to put a player's board in place or to draw
+// into a layer's texture
+static int origin_x = 0, origin_y = 0;
+static int player = 0;
+
+// A layer is drawn into its own texture once and copied to the screen from
+// then on, until its key changes. The board and the panel beside it only
+// change when a piece locks, rows clear or garbage comes in, and the game's
+// version goes up with every one of those, so it is their key.
+struct Layer {
+    SDL_Texture* texture;
+    SDL_Rect rect;
+    uint64_t key;
+    int valid;
+};
+static struct Layer stack_layers[MAX_PLAYERS], panel_layers[MAX_PLAYERS], dialog_layer;
+// without render targets everything is drawn every frame as before
+static int layers_supported = 0;
+
+static void pushQuad(const SDL_Rect* src, const SDL_Rect* dst, int quarter_turns, const SDL_Point* center, SDL_Color color);
+
+void setPlayer(int p) {
+    player = p;
+    origin_x = p*PLAYER_WIDTH;
+}
+
+void invalidateLayers() {
+    for (int p = 0; p < MAX_PLAYERS; p++) {
+        stack_layers[p].valid = 0;
+        panel_layers[p].valid = 0;
+    }
+    dialog_layer.valid = 0;
+}
+
+// brings layer up to date with draw if key has changed, then copies it to
+// the screen at its rect
+static void drawLayer(struct Layer* layer, uint64_t key, void (*draw)(const void* arg), const void* arg) {
+    // whatever is queued goes under the layer
+    flushSprites();
+
+    if (layers_supported && layer->texture == NULL) {
+        layer->texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, layer->rect.w, layer->rect.h);
+        if (layer->texture == NULL) {
+            SDL_Log("Couldn't make a layer, drawing everything every frame: %s\n", SDL_GetError());
+            layers_supported = 0;
+        } else {
+            SDL_SetTextureBlendMode(layer->texture, SDL_BLENDMODE_BLEND);
+        }
+    }
+    if (!layers_supported) {
+        draw(arg);
+        flushSprites();
+        return;
+    }
+
+    int x = origin_x, y = origin_y;
+    if (!layer->valid || layer->key != key) {
+        SDL_SetRenderTarget(renderer, layer->texture);
+        SDL_SetRenderDrawColor(renderer, 0, 0, 0, 0);
+        SDL_RenderClear(renderer);
+        origin_x = -layer->rect.x;
+        origin_y = -layer->rect.y;
+        draw(arg);
+        flushSprites();
+        origin_x = x;
+        origin_y = y;
+        SDL_SetRenderTarget(renderer, NULL);
+        layer->key = key;
+        layer->valid = 1;
+    }
+
+    SDL_Rect dst = {x + layer->rect.x, y + layer->rect.y, layer->rect.w, layer->rect.h};
+    SDL_RenderCopy(renderer, layer->texture, NULL, &dst);
+}
+
+// the piece's sprite turned to its orientation, y pixels down the board
+static void pushPiece(const struct Piece* piece, int y, SDL_Color color) {
+    const struct Orientation* spawn = &orientations[piece->type][0];
+    const struct Orientation* or = &orientations[piece->type][(int)piece->orientation];
+    int w = spawn->w*SQUARE_SIZE;
+    int h = spawn->h*SQUARE_SIZE;
+    int r_x = w/2 - ((w/2) % SQUARE_SIZE);
+    int r_y = h/2 - ((h/2) % SQUARE_SIZE);
+    SDL_Point p = {r_x, r_y};
+    SDL_Rect rect = {BOARD_X + (piece->x - or->dx)*SQUARE_SIZE, BOARD_Y + y - or->dy*SQUARE_SIZE, w, h};
+    pushQuad(&atlas_rects[piece->type], &rect, piece->orientation, &p, color);
+}
+
+// where the active piece will land, faded, drawn before the piece so it
+// never covers it
+void drawGhost(const struct Game* game) {
+    SDL_Color faded = {0xff, 0xff, 0xff, 0x50};
+    pushPiece(&game->active, (game->active.y + dropDistance(game))*SQUARE_SIZE, faded);
+}
+
+void drawActivePiece(const struct Piece* piece, int fall) {
+    PROFILE_SCOPE(PHASE_DRAW_ACTIVE);
+    pushPiece(piece, piece->y*SQUARE_SIZE + fall, (SDL_Color){0xff, 0xff, 0xff, 0xff});
+
+    SDL_SetRenderDrawColor(renderer, 127, 127, 127, 127);
+    SDL_RenderDrawPoint(renderer, origin_x + BOARD_X + piece->x*SQUARE_SIZE, origin_y + BOARD_Y + piece->y*SQUARE_SIZE);
+}
+
+void drawQueue(const struct Game* game) {
+    PROFILE_SCOPE(PHASE_DRAW_QUEUE);
+    for (int n = 0; n < QUEUE_CAPACITY; n++) {
+        unsigned char type;
+        if (peekPieceRing(&game->queue, n, &type) < 0)
+            break;
+        const struct Orientation* spawn = &orientations[type][0];
+        SDL_Rect rect = {QUEUE_X + SQUARE_SIZE, QUEUE_Y + SQUARE_SIZE*(4*n+1), spawn->w*SQUARE_SIZE, spawn->h*SQUARE_SIZE};
+        pushSprite(&atlas_rects[type], &rect, 0, NULL);
+    }
+}
+
+void drawBoard(const struct Game* game) {
+    PROFILE_SCOPE(PHASE_DRAW_BOARD);
+    for (int m = 0; m < BOARD_WIDTH; m++) {
+        for (int n = 0; n < BOARD_HEIGHT; n++) {
+            int c = game->colors[n][m];
+            if (c < 0)
+                continue;
+
+            SDL_Rect dst_rect = {BOARD_X + m*SQUARE_SIZE, BOARD_Y + n*SQUARE_SIZE, SQUARE_SIZE, SQUARE_SIZE};
+            // garbage is an O block in grey
+            if (c == GARBAGE) {
+                SDL_Rect src_rect = {atlas_rects[O].x, atlas_rects[O].y, 16, 16};
+                pushQuad(&src_rect, &dst_rect, 0, NULL, (SDL_Color){0x60, 0x60, 0x60, 0xff});
+                continue;
+            }
+
+            // S and T have no block in their top left corner
+            SDL_Rect src_rect = {atlas_rects[c].x + ((c == S || c == T) ? 16 : 0), atlas_rects[c].y, 16, 16};
+            pushSprite(&src_rect, &dst_rect, 0, NULL);
+        }
+    }
+}
+
+#define HUD_X (QUEUE_X + SQUARE_SIZE)
+#define HUD_Y (QUEUE_Y + (QUEUE_HEIGHT+1)*SQUARE_SIZE)
+
+// score, level and lines, under the queue
+static void drawScores(const struct Game* game) {
+    SDL_Color white = {0xff, 0xff, 0xff, 0xff};
+    char line[32];
+    int y = HUD_Y;
+
+    snprintf(line, sizeof(line), "Score %d", game->score);
+    drawText(line, HUD_X, y, white);
+    y += glyph_height;
+    snprintf(line, sizeof(line), "Level %d", game->level);
+    drawText(line, HUD_X, y, white);
+    y += glyph_height;
+    snprintf(line, sizeof(line), "Lines %d", game->lines);
+    drawText(line, HUD_X, y, white);
+}
+
+void drawRate(const struct Game* game, uint64_t ticks) {
+    SDL_Color white = {0xff, 0xff, 0xff, 0xff};
+    char line[32];
+    snprintf(line, sizeof(line), "%.2f pieces/s", ticks ? (double)game->pieces*TICK_RATE/ticks : 0.0);
+    drawText(line, HUD_X, HUD_Y + 3*glyph_height, white);
+}
+
+// lines go over the sprites, so these come after flushSprites
+static void drawBoardOutline() {
+    int x = origin_x, y = origin_y;
+    SDL_SetRenderDrawColor(renderer, 127, 127, 127, 127);
+    SDL_RenderDrawLine(renderer, x, y, x, y + BOARD_HEIGHT*SQUARE_SIZE);
+    SDL_RenderDrawLine(renderer, x, y, x + BOARD_WIDTH*SQUARE_SIZE, y);
+    SDL_RenderDrawLine(renderer, x + BOARD_WIDTH*SQUARE_SIZE, y, x + BOARD_WIDTH*SQUARE_SIZE, y + BOARD_HEIGHT*SQUARE_SIZE);
+    SDL_RenderDrawLine(renderer, x, y + BOARD_HEIGHT*SQUARE_SIZE, x + BOARD_WIDTH*SQUARE_SIZE, y + BOARD_HEIGHT*SQUARE_SIZE);
+}
+
+static void drawQueueOutline() {
+    SDL_SetRenderDrawColor(renderer, 127, 127, 127, 127);
+    SDL_Rect rect = {origin_x + QUEUE_X, origin_y + QUEUE_Y, QUEUE_WIDTH*SQUARE_SIZE, QUEUE_HEIGHT*SQUARE_SIZE};
+    SDL_RenderDrawRect(renderer, &rect);
+}
+
+static void drawStackLayer(const void* arg) {
+    drawBoard(arg);
+    flushSprites();
+    drawBoardOutline();
+}
+
+static void drawPanelLayer(const void* arg) {
+    drawQueue(arg);
+    drawScores(arg);
+    flushSprites();
+    drawQueueOutline();
+}
+
+void drawStack(const struct Game* game) {
+    drawLayer(&stack_layers[player], game->version, drawStackLayer, game);
+}
+
+void drawPanel(const struct Game* game) {
+    drawLayer(&panel_layers[player], game->version, drawPanelLayer, game);
+}
+
+#define DIALOG_W 300
+#define DIALOG_H 200
+
+static void drawDialogLayer(const void* arg) {
+    const char* text = arg;
+    SDL_Rect box = {origin_x + dialog_layer.rect.x, origin_y + dialog_layer.rect.y, DIALOG_W, DIALOG_H};
+    SDL_SetRenderDrawColor(renderer, 0x7F, 0x7F, 0x7F, 0xFF);
+    SDL_RenderFillRect(renderer, &box);
+
+    SDL_Color black = {0, 0, 0, 0xff};
+    drawText(text, box.x + DIALOG_W/2 - textWidth(text)/2, box.y + DIALOG_H/2 - glyph_height/2, black);
+}
+
+void drawDialog(const char* text, int x, int y) {
+    // FNV-1a of the text, a different message redraws it
+    uint64_t key = 14695981039346656037ull;
+    for (const char* c = text; *c; c++)
+        key = (key ^ (unsigned char)*c)*1099511628211ull;
+
+    dialog_layer.rect.x = x - DIALOG_W/2;
+    dialog_layer.rect.y = y - DIALOG_H/2;
+    drawLayer(&dialog_layer, key, drawDialogLayer, text);
+}
+
+// queues src from the atlas to be drawn at dst, turned clockwise about
+// center like SDL_RenderCopyEx would, with the texture multiplied by color
+static void pushQuad(const SDL_Rect* src, const SDL_Rect* dst, int quarter_turns, const SDL_Point* center, SDL_Color color) {
+    if (sprite_count == MAX_SPRITES)
+        flushSprites();
+
+    SDL_Point pivot = center ? *center : (SDL_Point){dst->w/2, dst->h/2};
+    int corners[4][2] = {{0, 0}, {dst->w, 0}, {dst->w, dst->h}, {0, dst->h}};
+    float u0 = (float)src->x/atlas_w, u1 = (float)(src->x + src->w)/atlas_w;
+    float v0 = (float)src->y/atlas_h, v1 = (float)(src->y + src->h)/atlas_h;
+    float uv[4][2] = {{u0, v0}, {u1, v0}, {u1, v1}, {u0, v1}};
+
+    SDL_Vertex* v = &vertices[4*sprite_count++];
+    for (int k = 0; k < 4; k++) {
+        int x = corners[k][0] - pivot.x;
+        int y = corners[k][1] - pivot.y;
+        // y points down, so a clockwise quarter turn takes (x, y) to (-y, x)
+        for (int t = 0; t < quarter_turns; t++) {
+            int temp = x;
+            x = -y;
+            y = temp;
+        }
+        v[k].position.x = origin_x + dst->x + pivot.x + x;
+        v[k].position.y = origin_y + dst->y + pivot.y + y;
+        v[k].color = color;
+        v[k].tex_coord.x = uv[k][0];
+        v[k].tex_coord.y = uv[k][1];
+    }
+}
+
+void pushSprite(const SDL_Rect* src, const SDL_Rect* dst, int quarter_turns, const SDL_Point* center) {
+    pushQuad(src, dst, quarter_turns, center, (SDL_Color){0xff, 0xff, 0xff, 0xff});
+}
+
+static const struct Glyph* findGlyph(char c) {
+    if (c < PACK_FIRST_GLYPH || c > PACK_LAST_GLYPH)
+        c = ' ';
+    return &glyphs[c - PACK_FIRST_GLYPH];
+}
+
+int textWidth(const char* text) {
+    int w = 0;
+    for (; *text; text++)
+        w += findGlyph(*text)->advance;
+    return w;
+}
+
+int textHeight() {
+    return glyph_height;
+}
+
+int drawText(const char* text, int x, int y, SDL_Color color) {
+    int start = x;
+    for (; *text; text++) {
+        const struct Glyph* glyph = findGlyph(*text);
+        if (glyph->rect.w > 0) {
+            SDL_Rect dst = {x, y, glyph->rect.w, glyph->rect.h};
+            pushQuad(&glyph->rect, &dst, 0, NULL, color);
+        }
+        x += glyph->advance;
+    }
+    return x - start;
+}
+
+void flushSprites() {
+    PROFILE_SCOPE(PHASE_FLUSH);
+    if (sprite_count == 0)
+        return;
+
+    if (SDL_RenderGeometry(renderer, atlas, vertices, 4*sprite_count, indices, 6*sprite_count) < 0)
+        SDL_Log("Couldn't draw sprites: %s\n", SDL_GetError());
+    sprite_count = 0;
+}
+
+static SDL_Rect toRect(struct PackRect rect) {
+    return (SDL_Rect){rect.x, rect.y, rect.w, rect.h};
+}
+
+int initRender(const struct Pack* pack) {
+    const struct PackHeader* header = pack->header;
+    atlas_w = header->width;
+    atlas_h = header->height;
+
+    // the pixels go straight to the texture, there is nothing to convert
+    atlas = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_STATIC, atlas_w, atlas_h);
+    if (atlas == NULL || SDL_UpdateTexture(atlas, NULL, pack->pixels, 4*atlas_w) < 0) {
+        SDL_Log("Couldn't upload the sprite atlas: %s\n", SDL_GetError());
+        destroyRender();
+        return -1;
+    }
+    SDL_SetTextureBlendMode(atlas, SDL_BLENDMODE_BLEND);
+
+    for (int n = 0; n < 7; n++)
+        atlas_rects[n] = toRect(header->sprites[n]);
+    for (int n = 0; n < PACK_GLYPHS; n++) {
+        glyphs[n].rect = toRect(header->glyphs[n].rect);
+        glyphs[n].advance = header->glyphs[n].advance;
+    }
+    glyph_height = header->glyph_height;
+
+    // the panel is wide enough for the scores to run past the queue
+    layers_supported = SDL_RenderTargetSupported(renderer);
+    for (int p = 0; p < MAX_PLAYERS; p++) {
+        stack_layers[p].rect = (SDL_Rect){BOARD_X, BOARD_Y, BOARD_WIDTH*SQUARE_SIZE + 1, BOARD_HEIGHT*SQUARE_SIZE + 1};
+        panel_layers[p].rect = (SDL_Rect){QUEUE_X, QUEUE_Y, PANEL_WIDTH, BOARD_HEIGHT*SQUARE_SIZE + 1};
+    }
+    dialog_layer.rect = (SDL_Rect){0, 0, DIALOG_W, DIALOG_H};
+    invalidateLayers();
+
+    // every quad is two triangles over its four corners
+    for (int n = 0; n < MAX_SPRITES; n++) {
+        int quad[6] = {0, 1, 2, 0, 2, 3};
+        for (int k = 0; k < 6; k++)
+            indices[6*n + k] = 4*n + quad[k];
+    }
+    sprite_count = 0;
+    return 0;
+}
+
+static void destroyLayer(struct Layer* layer) {
+    if (layer->texture)
+        SDL_DestroyTexture(layer->texture);
+    layer->texture = NULL;
+    layer->valid = 0;
+}
+
+void destroyRender() {
+    if (atlas)
+        SDL_DestroyTexture(atlas);
+    atlas = NULL;
+
+    for (int p = 0; p < MAX_PLAYERS; p++) {
+        destroyLayer(&stack_layers[p]);
+        destroyLayer(&panel_layers[p]);
+    }
+    destroyLayer(&dialog_layer);
+}
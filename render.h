@@ -0,0 +1,59 @@
+#ifndef RENDER_H
+#define RENDER_H
+
+#include <SDL2/SDL.h>
+
+#include "engine.h"
+#include "pack.h"
+
+#define SQUARE_SIZE 16
+#define BOARD_X 0
+#define BOARD_Y 0
+
+#define QUEUE_WIDTH 6
+#define QUEUE_HEIGHT 12
+#define QUEUE_X (BOARD_X + BOARD_WIDTH*SQUARE_SIZE)
+#define QUEUE_Y 0
+// one board, its queue and a gap, the second versus board starts here
+#define PLAYER_WIDTH (QUEUE_X + (QUEUE_WIDTH+1)*SQUARE_SIZE)
+#define PANEL_WIDTH (15*SQUARE_SIZE)
+#define MAX_PLAYERS 2
+
+// set up by the caller, everything here draws to it
+extern SDL_Renderer* renderer;
+
+// uploads the pack's atlas, the pack can be freed once this returns
+int initRender(const struct Pack* pack);
+void destroyRender();
+
+// everything drawn after this is for player, whose board is to the right
+// of the ones before it
+void setPlayer(int player);
+// the layers' textures are gone, after SDL_RENDER_TARGETS_RESET
+void invalidateLayers();
+
+void pushSprite(const SDL_Rect* src, const SDL_Rect* dst, int quarter_turns, const SDL_Point* center);
+void flushSprites();
+
+// text is queued with the sprites, no texture is made for it. Returns the
+// width drawn, x and y are the top left corner.
+int drawText(const char* text, int x, int y, SDL_Color color);
+int textWidth(const char* text);
+int textHeight();
+
+void drawBoard(const struct Game* game);
+void drawQueue(const struct Game* game);
+// The locked cells and the border, then the queue with the score, level
+// and lines. Each comes from a texture that is only redrawn when a piece
+// locks, rows clear or garbage comes in.
+void drawStack(const struct Game* game);
+void drawPanel(const struct Game* game);
+// pieces per second over ticks of play, under the panel's scores
+void drawRate(const struct Game* game, uint64_t ticks);
+void drawGhost(const struct Game* game);
+// fall moves it that many pixels further down, to slide it between rows
+void drawActivePiece(const struct Piece* piece, int fall);
+// a box with text in it centred on x, y, kept as a texture too
+void drawDialog(const char* text, int x, int y);
+
+#endif
@@ -0,0 +1,154 @@
+#include "replay.h"
+#include <stdlib.h>
+#include <string.h>
+
+static const char magic[4] = {'T', 'R', 'P', 'L'};
+
+static int putVarint(FILE* file, uint64_t value) {
+    while (value >= 0x80) {
+        if (putc((value & 0x7f) | 0x80, file) == EOF)
+            return -1;
+        value >>= 7;
+    }
+    return putc(value, file) == EOF ? -1 : 0;
+}
+
+static int putLittle(FILE* file, uint64_t value, int bytes) {
+    for (int n = 0; n < bytes; n++) {
+        if (putc((value >> 8*n) & 0xff, file) == EOF)
+            return -1;
+    }
+    return 0;
+}
+
+// returns the bytes read, or 0 if the varint runs past end
+static size_t getVarint(const unsigned char* p, const unsigned char* end, uint64_t* value) {
+    *value = 0;
+    for (size_t n = 0; p + n < end && n < 10; n++) {
+        *value |= (uint64_t)(p[n] & 0x7f) << 7*n;
+        if (!(p[n] & 0x80))
+            return n+1;
+    }
+    return 0;
+}
+
+static uint64_t getLittle(const unsigned char* p, int bytes) {
+    uint64_t value = 0;
+    for (int n = 0; n < bytes; n++)
+        value |= (uint64_t)p[n] << 8*n;
+    return value;
+}
+
+int openReplay(struct ReplayWriter* writer, const char* path, uint64_t seed, enum RandomizerMode mode) {
+    if ((writer->file = fopen(path, "wb")) == NULL)
+        return -1;
+
+    // inputs trickle in during play, only write to the file in big blocks
+    setvbuf(writer->file, writer->buffer, _IOFBF, sizeof(writer->buffer));
+    writer->tick = 0;
+
+    fwrite(magic, 1, sizeof(magic), writer->file);
+    putc(REPLAY_VERSION, writer->file);
+    putc(mode, writer->file);
+    return putLittle(writer->file, seed, 8);
+}
+
+int recordInput(struct ReplayWriter* writer, uint64_t tick, enum Input input) {
+    uint64_t delta = tick - writer->tick;
+    writer->tick = tick;
+    return putVarint(writer->file, delta << 3 | input);
+}
+
+int closeReplay(struct ReplayWriter* writer, uint64_t ticks, const struct Game* game) {
+    int result = recordInput(writer, ticks, INPUT_NONE);
+    result |= putLittle(writer->file, game->score, 4);
+    result |= putLittle(writer->file, game->lines, 4);
+    result |= putLittle(writer->file, game->hash, 8);
+    if (fclose(writer->file) == EOF)
+        result = -1;
+    return result;
+}
+
+int loadReplay(struct Replay* replay, const char* path) {
+    FILE* file = fopen(path, "rb");
+    if (file == NULL)
+        return -1;
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    replay->data = NULL;
+    if (size >= REPLAY_HEADER_SIZE && (replay->data = malloc(size)) != NULL) {
+        if (fread(replay->data, 1, size, file) != (size_t)size) {
+            free(replay->data);
+            replay->data = NULL;
+        }
+    }
+    fclose(file);
+
+    if (replay->data == NULL)
+        return -1;
+
+    const unsigned char* p = replay->data;
+    const unsigned char* end = p + size;
+    if (memcmp(p, magic, sizeof(magic)) || p[4] != REPLAY_VERSION || p[5] > RANDOM_BAG) {
+        freeReplay(replay);
+        return -1;
+    }
+    replay->mode = p[5];
+    replay->seed = getLittle(p+6, 8);
+    replay->events = p + REPLAY_HEADER_SIZE;
+
+    // find the end marker, checking every event is whole on the way
+    replay->ticks = 0;
+    for (p = replay->events; ;) {
+        uint64_t event;
+        size_t length = getVarint(p, end, &event);
+        if (length == 0 || (event & 7) > INPUT_HARD_DROP) {
+            freeReplay(replay);
+            return -1;
+        }
+        p += length;
+        replay->ticks += event >> 3;
+        if ((event & 7) == INPUT_NONE)
+            break;
+    }
+
+    if (end - p != 16) {
+        freeReplay(replay);
+        return -1;
+    }
+    replay->events_size = p - replay->events;
+    replay->score = getLittle(p, 4);
+    replay->lines = getLittle(p+4, 4);
+    replay->hash = getLittle(p+8, 8);
+    return 0;
+}
+
+void freeReplay(struct Replay* replay) {
+    free(replay->data);
+    replay->data = NULL;
+}
+
+int playReplay(const struct Replay* replay, struct Game* game) {
+    initGame(game, replay->seed, replay->mode);
+
+    // inputs on a tick go before its gravity, same as in the main loop
+    uint64_t at = 0, ticked = 0;
+    const unsigned char* p = replay->events;
+    const unsigned char* end = p + replay->events_size;
+    while (p < end) {
+        uint64_t event;
+        p += getVarint(p, end, &event);
+        at += event >> 3;
+
+        for (; ticked < at && game->state == GAME; ticked++)
+            tick(game);
+        step(game, event & 7);
+    }
+
+    if (game->score != replay->score || game->lines != replay->lines || game->hash != replay->hash)
+        return -1;
+    return 0;
+}
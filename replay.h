@@ -0,0 +1,51 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "engine.h"
+
+// A replay is the seed and every input with the tick it was applied on.
+// After a 14 byte header of "TRPL", the version, the randomizer mode and
+// the 64 bit seed, each input
+// is a LEB128 varint of (ticks since the last input << 3 | input). An
+// INPUT_NONE marks the end, its delta reaching the last tick, and is
+// followed by the final score, lines and game hash to check against.
+// Everything is little endian.
+#define REPLAY_VERSION 2
+#define REPLAY_HEADER_SIZE 14
+#define REPLAY_BUFFER_SIZE 65536
+
+struct ReplayWriter {
+    FILE* file;
+    uint64_t tick;
+    char buffer[REPLAY_BUFFER_SIZE];
+};
+
+struct Replay {
+    unsigned char* data;
+    uint64_t seed;
+    enum RandomizerMode mode;
+    const unsigned char* events;
+    size_t events_size;
+
+    uint64_t ticks;
+    int score;
+    int lines;
+    uint64_t hash;
+};
+
+int openReplay(struct ReplayWriter* writer, const char* path, uint64_t seed, enum RandomizerMode mode);
+// inputs must be recorded in the order they were applied
+int recordInput(struct ReplayWriter* writer, uint64_t tick, enum Input input);
+// ticks is how many ticks ran, game is where they left it
+int closeReplay(struct ReplayWriter* writer, uint64_t ticks, const struct Game* game);
+
+int loadReplay(struct Replay* replay, const char* path);
+void freeReplay(struct Replay* replay);
+// plays the replay into game as fast as possible, returns 0 if it ends
+// with the recorded score, lines and hash
+int playReplay(const struct Replay* replay, struct Game* game);
+
+#endif
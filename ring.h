@@ -0,0 +1,157 @@
+#ifndef RING_H
+#define RING_H
+
+#include <stdatomic.h>
+
+#define CACHE_LINE 64
+
+// DEFINE_RING(Name, type, capacity) declares struct Name, a lock-free ring
+// of capacity items for one producer thread and one consumer thread, which
+// may be the same thread. capacity must be a power of two. It also defines
+//
+//   initName(ring)
+//   pushName(ring, item)             0, or -1 if full
+//   popName(ring, &item)             0, or -1 if empty
+//   fillName(ring, items, count)     pushes up to count, returns how many
+//   drainName(ring, items, count)    pops up to count, returns how many
+//   peekName(ring, depth, &item)     copies the item depth places from the
+//                                    front without popping it, 0 or -1
+//   sizeName(ring)                   items in the ring
+//
+// head and tail count every item ever popped and pushed and are only
+// masked when indexing, so they can wrap freely. Each side keeps its own
+// copy of the other's counter and only reloads it when that copy says the
+// ring is full or empty, so the two threads rarely touch each other's
+// cache line.
+#define DEFINE_RING(name, type, capacity) \
+_Static_assert(((capacity) & ((capacity)-1)) == 0, #name " capacity must be a power of two"); \
+\
+struct name { \
+    /* written by the producer */ \
+    _Alignas(CACHE_LINE) atomic_uint tail; \
+    unsigned head_cache; \
+    /* written by the consumer */ \
+    _Alignas(CACHE_LINE) atomic_uint head; \
+    unsigned tail_cache; \
+    _Alignas(CACHE_LINE) type items[capacity]; \
+}; \
+\
+static inline void init##name(struct name* ring) { \
+    atomic_init(&ring->tail, 0); \
+    atomic_init(&ring->head, 0); \
+    ring->head_cache = 0; \
+    ring->tail_cache = 0; \
+} \
+\
+static inline int fill##name(struct name* ring, const type* items, int count) { \
+    unsigned tail = atomic_load_explicit(&ring->tail, memory_order_relaxed); \
+    unsigned space = (capacity) - (tail - ring->head_cache); \
+    if (space < (unsigned)count) { \
+        ring->head_cache = atomic_load_explicit(&ring->head, memory_order_acquire); \
+        space = (capacity) - (tail - ring->head_cache); \
+    } \
+    if ((unsigned)count > space) \
+        count = space; \
+    for (int n = 0; n < count; n++) \
+        ring->items[(tail + n) & ((capacity)-1)] = items[n]; \
+    atomic_store_explicit(&ring->tail, tail + count, memory_order_release); \
+    return count; \
+} \
+\
+static inline int drain##name(struct name* ring, type* items, int count) { \
+    unsigned head = atomic_load_explicit(&ring->head, memory_order_relaxed); \
+    unsigned available = ring->tail_cache - head; \
+    if (available < (unsigned)count) { \
+        ring->tail_cache = atomic_load_explicit(&ring->tail, memory_order_acquire); \
+        available = ring->tail_cache - head; \
+    } \
+    if ((unsigned)count > available) \
+        count = available; \
+    for (int n = 0; n < count; n++) \
+        items[n] = ring->items[(head + n) & ((capacity)-1)]; \
+    atomic_store_explicit(&ring->head, head + count, memory_order_release); \
+    return count; \
+} \
+\
+static inline int push##name(struct name* ring, type item) { \
+    return fill##name(ring, &item, 1) == 1 ? 0 : -1; \
+} \
+\
+static inline int pop##name(struct name* ring, type* item) { \
+    return drain##name(ring, item, 1) == 1 ? 0 : -1; \
+} \
+\
+static inline int peek##name(const struct name* ring, int depth, type* item) { \
+    unsigned head = atomic_load_explicit(&ring->head, memory_order_relaxed); \
+    unsigned tail = atomic_load_explicit(&ring->tail, memory_order_acquire); \
+    if ((unsigned)depth >= tail - head) \
+        return -1; \
+    *item = ring->items[(head + depth) & ((capacity)-1)]; \
+    return 0; \
+} \
+\
+static inline int size##name(const struct name* ring) { \
+    unsigned head = atomic_load_explicit(&ring->head, memory_order_acquire); \
+    return atomic_load_explicit(&ring->tail, memory_order_acquire) - head; \
+}
+
+
+// DEFINE_LOCAL_RING(Name, type, capacity) is the same ring for a queue that
+// never leaves one thread, like a game's preview. It has the same functions
+// but plain counters and no padding, so it is only as big as its items and
+// copying the struct it sits in stays cheap. capacity is at most 128.
+#define DEFINE_LOCAL_RING(name, type, capacity) \
+_Static_assert(((capacity) & ((capacity)-1)) == 0, #name " capacity must be a power of two"); \
+/* the counters are bytes, they wrap at 256 */ \
+_Static_assert((capacity) <= 128, #name " capacity must fit its byte counters"); \
+\
+struct name { \
+    unsigned char head, tail; \
+    type items[capacity]; \
+}; \
+\
+static inline void init##name(struct name* ring) { \
+    ring->head = 0; \
+    ring->tail = 0; \
+} \
+\
+static inline int fill##name(struct name* ring, const type* items, int count) { \
+    unsigned space = (capacity) - (unsigned char)(ring->tail - ring->head); \
+    if ((unsigned)count > space) \
+        count = space; \
+    for (int n = 0; n < count; n++) \
+        ring->items[(ring->tail + n) & ((capacity)-1)] = items[n]; \
+    ring->tail += count; \
+    return count; \
+} \
+\
+static inline int drain##name(struct name* ring, type* items, int count) { \
+    unsigned available = (unsigned char)(ring->tail - ring->head); \
+    if ((unsigned)count > available) \
+        count = available; \
+    for (int n = 0; n < count; n++) \
+        items[n] = ring->items[(ring->head + n) & ((capacity)-1)]; \
+    ring->head += count; \
+    return count; \
+} \
+\
+static inline int push##name(struct name* ring, type item) { \
+    return fill##name(ring, &item, 1) == 1 ? 0 : -1; \
+} \
+\
+static inline int pop##name(struct name* ring, type* item) { \
+    return drain##name(ring, item, 1) == 1 ? 0 : -1; \
+} \
+\
+static inline int peek##name(const struct name* ring, int depth, type* item) { \
+    if ((unsigned)depth >= (unsigned char)(ring->tail - ring->head)) \
+        return -1; \
+    *item = ring->items[(ring->head + depth) & ((capacity)-1)]; \
+    return 0; \
+} \
+\
+static inline int size##name(const struct name* ring) { \
+    return (unsigned char)(ring->tail - ring->head); \
+}
+
+#endif
@@ -0,0 +1,225 @@
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "piece.h"
+#include "ring.h"
+
+#define BATCH 64
+#define CROSS_CAPACITY 1024
+
+// the queue.c this replaced, kept here to measure against
+struct Queue {
+    int front, back, size;
+    unsigned capacity;
+    struct Piece* array;
+};
+
+static void initQueue(struct Queue* queue, struct Piece* array, int capacity) {
+    queue->front = 0;
+    queue->back = 0;
+    queue->size = 0;
+    queue->capacity = capacity;
+    queue->array = array;
+}
+
+static int enqueue(struct Queue* queue, struct Piece piece) {
+    if (queue->size+1 > queue->capacity)
+        return -1;
+
+    memcpy(&queue->array[queue->back], &piece, sizeof(struct Piece));
+    queue->back = (queue->back+1)%queue->capacity;
+    queue->size = queue->size + 1;
+    return 0;
+}
+
+static struct Piece* dequeue(struct Queue* queue) {
+    if (queue->size <= 0)
+        return NULL;
+
+    struct Piece* p = &(queue->array[queue->front]);
+    queue->front = (queue->front+1)%queue->capacity;
+    queue->size = queue->size - 1;
+    return p;
+}
+
+DEFINE_LOCAL_RING(PreviewRing, struct Piece, 4)
+DEFINE_RING(MessageRing, uint32_t, CROSS_CAPACITY)
+
+// the old queue shared between threads needs a lock
+struct LockedQueue {
+    pthread_mutex_t lock;
+    struct Queue queue;
+    struct Piece array[CROSS_CAPACITY];
+};
+
+struct Shared {
+    long messages;
+    int batch;
+    struct LockedQueue locked;
+    struct MessageRing ring;
+    uint64_t sum;
+};
+
+static double now() {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec/1e9;
+}
+
+// keeps three pieces queued and cycles one through per message, the way
+// the preview is used
+static double previewQueue(long messages, uint64_t* sum) {
+    struct Piece array[3];
+    struct Queue queue;
+    initQueue(&queue, array, 3);
+    for (int n = 0; n < 3; n++)
+        enqueue(&queue, (struct Piece){n, 0, 0, 0});
+
+    double start = now();
+    for (long n = 0; n < messages; n++) {
+        *sum += dequeue(&queue)->type;
+        enqueue(&queue, (struct Piece){n%7, 0, 0, 0});
+    }
+    return now() - start;
+}
+
+static double previewRing(long messages, uint64_t* sum) {
+    struct PreviewRing ring;
+    initPreviewRing(&ring);
+    for (int n = 0; n < 3; n++)
+        pushPreviewRing(&ring, (struct Piece){n, 0, 0, 0});
+
+    double start = now();
+    for (long n = 0; n < messages; n++) {
+        struct Piece piece;
+        popPreviewRing(&ring, &piece);
+        *sum += piece.type;
+        pushPreviewRing(&ring, (struct Piece){n%7, 0, 0, 0});
+    }
+    return now() - start;
+}
+
+static void* produceLocked(void* arg) {
+    struct Shared* shared = arg;
+    for (long n = 0; n < shared->messages;) {
+        pthread_mutex_lock(&shared->locked.lock);
+        int full = enqueue(&shared->locked.queue, (struct Piece){n%7, 0, 0, 0}) < 0;
+        pthread_mutex_unlock(&shared->locked.lock);
+        if (full)
+            sched_yield();
+        else
+            n++;
+    }
+    return NULL;
+}
+
+static void* consumeLocked(void* arg) {
+    struct Shared* shared = arg;
+    for (long n = 0; n < shared->messages;) {
+        pthread_mutex_lock(&shared->locked.lock);
+        struct Piece* p = dequeue(&shared->locked.queue);
+        if (p) {
+            shared->sum += p->type;
+            n++;
+        }
+        pthread_mutex_unlock(&shared->locked.lock);
+        if (!p)
+            sched_yield();
+    }
+    return NULL;
+}
+
+static void* produceRing(void* arg) {
+    struct Shared* shared = arg;
+    uint32_t batch[BATCH];
+    for (long n = 0; n < shared->messages;) {
+        int count = shared->messages - n < shared->batch ? shared->messages - n : shared->batch;
+        for (int k = 0; k < count; k++)
+            batch[k] = (n+k)%7;
+
+        int pushed = fillMessageRing(&shared->ring, batch, count);
+        // a partial push leaves the rest to go again
+        if (pushed == 0)
+            sched_yield();
+        n += pushed;
+    }
+    return NULL;
+}
+
+static void* consumeRing(void* arg) {
+    struct Shared* shared = arg;
+    uint32_t batch[BATCH];
+    for (long n = 0; n < shared->messages;) {
+        int popped = drainMessageRing(&shared->ring, batch, shared->batch);
+        if (popped == 0)
+            sched_yield();
+        for (int k = 0; k < popped; k++)
+            shared->sum += batch[k];
+        n += popped;
+    }
+    return NULL;
+}
+
+static double crossThreads(struct Shared* shared, void* (*produce)(void*), void* (*consume)(void*)) {
+    pthread_t producer, consumer;
+    shared->sum = 0;
+    double start = now();
+    pthread_create(&consumer, NULL, consume, shared);
+    pthread_create(&producer, NULL, produce, shared);
+    pthread_join(producer, NULL);
+    pthread_join(consumer, NULL);
+    return now() - start;
+}
+
+static void report(const char* name, long messages, double secs, uint64_t sum, uint64_t expected) {
+    printf("%-32s %12.0f messages/sec%s\n", name, messages/secs, sum == expected ? "" : "  WRONG SUM");
+}
+
+// the old queue against the ring, on one thread cycling the preview and
+// across two threads passing messages
+int main(int argc, char* argv[]) {
+    long messages = argc > 1 ? atol(argv[1]) : 10000000;
+
+    // each benchmark passes n%7 for n below messages
+    uint64_t expected = 0;
+    for (long n = 0; n < messages; n++)
+        expected += n%7;
+
+    // the preview starts with 0, 1, 2 queued, and n%7 for the last three n
+    // are still queued at the end
+    uint64_t preview_expected = 3 + expected;
+    for (long n = messages-3; n < messages; n++)
+        preview_expected -= n%7;
+
+    uint64_t sum = 0;
+    double secs = previewQueue(messages, &sum);
+    report("preview, queue.c", messages, secs, sum, preview_expected);
+    sum = 0;
+    secs = previewRing(messages, &sum);
+    report("preview, ring", messages, secs, sum, preview_expected);
+
+    struct Shared* shared = aligned_alloc(CACHE_LINE, (sizeof(struct Shared) + CACHE_LINE-1)/CACHE_LINE*CACHE_LINE);
+    shared->messages = messages;
+    pthread_mutex_init(&shared->locked.lock, NULL);
+    initQueue(&shared->locked.queue, shared->locked.array, CROSS_CAPACITY);
+    secs = crossThreads(shared, produceLocked, consumeLocked);
+    report("two threads, queue.c + mutex", messages, secs, shared->sum, expected);
+
+    shared->batch = 1;
+    initMessageRing(&shared->ring);
+    secs = crossThreads(shared, produceRing, consumeRing);
+    report("two threads, ring", messages, secs, shared->sum, expected);
+
+    shared->batch = BATCH;
+    initMessageRing(&shared->ring);
+    secs = crossThreads(shared, produceRing, consumeRing);
+    report("two threads, ring, batches of 64", messages, secs, shared->sum, expected);
+
+    free(shared);
+    return 0;
+}
@@ -0,0 +1,100 @@
+#include "rng.h"
+#include <string.h>
+
+static uint64_t splitmix(uint64_t* x) {
+    uint64_t z = (*x += 0x9e3779b97f4a7c15);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+    return z ^ (z >> 31);
+}
+
+static uint32_t rotl(uint32_t x, int k) {
+    return (x << k) | (x >> (32 - k));
+}
+
+void seedRng(struct Rng* rng, uint64_t seed) {
+    // splitmix spreads nearby seeds far apart, and never gives all zeros
+    uint64_t a = splitmix(&seed), b = splitmix(&seed);
+    rng->s[0] = a;
+    rng->s[1] = a >> 32;
+    rng->s[2] = b;
+    rng->s[3] = b >> 32;
+}
+
+uint32_t nextRandom(struct Rng* rng) {
+    uint32_t* s = rng->s;
+    uint32_t result = rotl(s[1]*5, 7)*9;
+    uint32_t t = s[1] << 9;
+
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotl(s[3], 11);
+    return result;
+}
+
+// Lemire's multiply and reject, almost never needs a division
+uint32_t randomBelow(struct Rng* rng, uint32_t bound) {
+    uint64_t m = (uint64_t)nextRandom(rng)*bound;
+    if ((uint32_t)m < bound) {
+        uint32_t threshold = -bound % bound;
+        while ((uint32_t)m < threshold)
+            m = (uint64_t)nextRandom(rng)*bound;
+    }
+    return m >> 32;
+}
+
+// a fresh bag into bag[0..7) in shuffled order
+static void shuffleBag(struct Rng* rng, unsigned char* bag) {
+    for (int n = 0; n < 7; n++)
+        bag[n] = n;
+    for (int n = 6; n > 0; n--) {
+        int k = randomBelow(rng, n+1);
+        unsigned char temp = bag[n];
+        bag[n] = bag[k];
+        bag[k] = temp;
+    }
+}
+
+void initRandomizer(struct Randomizer* randomizer, uint64_t seed, enum RandomizerMode mode) {
+    seedRng(&randomizer->rng, seed);
+    randomizer->mode = mode;
+    randomizer->bag_left = 0;
+}
+
+enum piece_type nextPiece(struct Randomizer* randomizer) {
+    if (randomizer->mode == RANDOM_UNIFORM)
+        return randomBelow(&randomizer->rng, 7);
+
+    if (randomizer->bag_left == 0) {
+        shuffleBag(&randomizer->rng, randomizer->bag);
+        randomizer->bag_left = 7;
+    }
+    // dealt from the back so what is left stays at the front
+    return randomizer->bag[--randomizer->bag_left];
+}
+
+void fillPieces(struct Randomizer* randomizer, unsigned char* pieces, int count) {
+    if (randomizer->mode == RANDOM_UNIFORM) {
+        for (int n = 0; n < count; n++)
+            pieces[n] = randomBelow(&randomizer->rng, 7);
+        return;
+    }
+
+    int n = 0;
+    while (n < count && randomizer->bag_left > 0)
+        pieces[n++] = randomizer->bag[--randomizer->bag_left];
+
+    // whole bags skip randomizer->bag, dealt back to front like nextPiece
+    unsigned char bag[7];
+    for (; count - n >= 7; n += 7) {
+        shuffleBag(&randomizer->rng, bag);
+        for (int k = 0; k < 7; k++)
+            pieces[n+k] = bag[6-k];
+    }
+
+    for (; n < count; n++)
+        pieces[n] = nextPiece(randomizer);
+}
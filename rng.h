@@ -0,0 +1,36 @@
+#ifndef RNG_H
+#define RNG_H
+
+#include <stdint.h>
+
+#include "piece.h"
+
+// xoshiro128**, small and fast, each game owns one so games never share
+// or disturb each other's sequences
+struct Rng {
+    uint32_t s[4];
+};
+
+enum RandomizerMode {RANDOM_UNIFORM, RANDOM_BAG};
+
+// uniform picks each piece independently, bag deals shuffled sets of all
+// seven so no piece is ever more than 12 pieces away
+struct Randomizer {
+    struct Rng rng;
+    enum RandomizerMode mode;
+    // the rest of the current bag is bag[0..bag_left)
+    unsigned char bag[7];
+    unsigned char bag_left;
+};
+
+void seedRng(struct Rng* rng, uint64_t seed);
+uint32_t nextRandom(struct Rng* rng);
+// uniform in [0, bound) with no modulo bias
+uint32_t randomBelow(struct Rng* rng, uint32_t bound);
+
+void initRandomizer(struct Randomizer* randomizer, uint64_t seed, enum RandomizerMode mode);
+enum piece_type nextPiece(struct Randomizer* randomizer);
+// the next count pieces, the same ones count calls to nextPiece would give
+void fillPieces(struct Randomizer* randomizer, unsigned char* pieces, int count);
+
+#endif
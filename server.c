@@ -0,0 +1,352 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "engine.h"
+#include "pool.h"
+#include "protocol.h"
+
+#define MAX_EVENTS 64
+#define IN_BUFFER 1024
+#define OUT_BUFFER 4096
+// reads per wakeup, so one busy client can't hold up the rest
+#define MAX_READS 16
+
+// one game per connection, only ever touched by the worker that accepted it
+struct Session {
+    int fd;
+    // waiting for the socket to drain before reading more
+    int blocked;
+    struct Game game;
+    int in_length;
+    int out_length, out_sent;
+    unsigned char in[IN_BUFFER];
+    unsigned char out[OUT_BUFFER];
+};
+
+struct ServerWorker {
+    pthread_t thread;
+    int epoll;
+    long sessions;
+    long requests;
+};
+
+static int listener;
+// written to on shutdown, every worker polls it
+static int stop_event;
+
+static void fillMove(struct MoveReply* reply, const struct Game* game, int result) {
+    reply->kind = REPLY_MOVE;
+    reply->result = result;
+    reply->state = game->state;
+    reply->piece = game->active.type;
+    reply->x = game->active.x;
+    reply->y = game->active.y;
+    reply->orientation = game->active.orientation;
+    reply->cleared = game->cleared;
+    reply->score = game->score;
+    reply->lines = game->lines;
+    reply->hash = game->hash;
+}
+
+static void fillState(struct StateReply* reply, const struct Game* game) {
+    memset(reply, 0, sizeof(*reply));
+    reply->kind = REPLY_STATE;
+    reply->state = game->state;
+    reply->piece = game->active.type;
+    reply->x = game->active.x;
+    reply->y = game->active.y;
+    reply->orientation = game->active.orientation;
+    for (int n = 0; n < QUEUE_CAPACITY; n++) {
+        unsigned char type = 0;
+        peekPieceRing(&game->queue, n, &type);
+        reply->queue[n] = type;
+    }
+    reply->level = game->level;
+    reply->hash = game->hash;
+    reply->score = game->score;
+    reply->lines = game->lines;
+    for (int m = 0; m < BOARD_HEIGHT; m++)
+        reply->board[m] = game->board[m];
+}
+
+// answers every whole request in the input buffer that there is room to
+// reply to, returns how many
+static int handleRequests(struct Session* session) {
+    int n = 0, handled = 0;
+    while (n < session->in_length) {
+        unsigned char msg = session->in[n];
+        int room = OUT_BUFFER - session->out_length;
+        unsigned char* out = &session->out[session->out_length];
+
+        if ((msg >= INPUT_LEFT && msg <= INPUT_HARD_DROP) || msg == MSG_TICK) {
+            if (room < (int)sizeof(struct MoveReply))
+                break;
+            int result = msg == MSG_TICK ? tick(&session->game) : step(&session->game, msg);
+            fillMove((struct MoveReply*)out, &session->game, result);
+            session->out_length += sizeof(struct MoveReply);
+            n++;
+        } else if (msg == MSG_STATE || msg == MSG_NEW) {
+            if (room < (int)sizeof(struct StateReply))
+                break;
+            if (msg == MSG_NEW) {
+                if (session->in_length - n < MSG_NEW_SIZE)
+                    break;
+                uint64_t seed;
+                memcpy(&seed, &session->in[n+1], sizeof(seed));
+                enum RandomizerMode mode = session->in[n+9] ? RANDOM_BAG : RANDOM_UNIFORM;
+                initGame(&session->game, seed, mode);
+                n += MSG_NEW_SIZE;
+            } else {
+                n++;
+            }
+            fillState((struct StateReply*)out, &session->game);
+            session->out_length += sizeof(struct StateReply);
+        } else {
+            // nothing to answer, skip it
+            n++;
+        }
+        handled++;
+    }
+
+    memmove(session->in, &session->in[n], session->in_length - n);
+    session->in_length -= n;
+    return handled;
+}
+
+// returns 1 once everything queued is sent, 0 if the socket is full and
+// -1 if the connection is gone
+static int flushSession(struct Session* session) {
+    while (session->out_sent < session->out_length) {
+        ssize_t sent = send(session->fd, &session->out[session->out_sent], session->out_length - session->out_sent, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR)
+                continue;
+            return errno == EAGAIN || errno == EWOULDBLOCK ? 0 : -1;
+        }
+        session->out_sent += sent;
+    }
+    session->out_length = 0;
+    session->out_sent = 0;
+    return 1;
+}
+
+static void closeSession(struct ServerWorker* worker, struct Session* session) {
+    epoll_ctl(worker->epoll, EPOLL_CTL_DEL, session->fd, NULL);
+    close(session->fd);
+    free(session);
+    worker->sessions--;
+}
+
+// reads and answers until the client has nothing more to say or the reply
+// can't be sent yet, in which case reading waits for EPOLLOUT
+static void serveSession(struct ServerWorker* worker, struct Session* session) {
+    for (int reads = 0;;) {
+        int flushed = flushSession(session);
+        if (flushed < 0) {
+            closeSession(worker, session);
+            return;
+        }
+        if (flushed == 0) {
+            if (!session->blocked) {
+                struct epoll_event event = {EPOLLOUT, {.ptr = session}};
+                epoll_ctl(worker->epoll, EPOLL_CTL_MOD, session->fd, &event);
+                session->blocked = 1;
+            }
+            return;
+        }
+        if (session->blocked) {
+            struct epoll_event event = {EPOLLIN, {.ptr = session}};
+            epoll_ctl(worker->epoll, EPOLL_CTL_MOD, session->fd, &event);
+            session->blocked = 0;
+        }
+
+        // requests left over from before the output filled up
+        int handled = session->in_length > 0 ? handleRequests(session) : 0;
+        if (handled > 0) {
+            worker->requests += handled;
+            continue;
+        }
+        // still readable, so epoll comes back to this session
+        if (reads == MAX_READS)
+            return;
+
+        ssize_t got = recv(session->fd, &session->in[session->in_length], IN_BUFFER - session->in_length, 0);
+        if (got < 0 && errno == EINTR)
+            continue;
+        if (got < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return;
+        if (got <= 0) {
+            closeSession(worker, session);
+            return;
+        }
+        session->in_length += got;
+        worker->requests += handleRequests(session);
+        reads++;
+    }
+}
+
+static void acceptSessions(struct ServerWorker* worker) {
+    for (;;) {
+        int fd = accept4(listener, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            return;
+        }
+
+        struct Session* session = malloc(sizeof(struct Session));
+        if (session == NULL) {
+            close(fd);
+            continue;
+        }
+        session->fd = fd;
+        session->blocked = 0;
+        session->in_length = 0;
+        session->out_length = 0;
+        session->out_sent = 0;
+        initGame(&session->game, 0, RANDOM_UNIFORM);
+
+        struct epoll_event event = {EPOLLIN, {.ptr = session}};
+        if (epoll_ctl(worker->epoll, EPOLL_CTL_ADD, fd, &event) < 0) {
+            close(fd);
+            free(session);
+            continue;
+        }
+        worker->sessions++;
+    }
+}
+
+// each worker has its own epoll set holding the listener and the sessions
+// it accepted, so sessions never move between threads
+static void* runServerWorker(void* arg) {
+    struct ServerWorker* worker = arg;
+    struct epoll_event events[MAX_EVENTS];
+
+    for (;;) {
+        int count = epoll_wait(worker->epoll, events, MAX_EVENTS, -1);
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count < 0)
+            break;
+
+        for (int n = 0; n < count; n++) {
+            if (events[n].data.ptr == &listener) {
+                acceptSessions(worker);
+            } else if (events[n].data.ptr == &stop_event) {
+                return NULL;
+            } else {
+                serveSession(worker, events[n].data.ptr);
+            }
+        }
+    }
+    return NULL;
+}
+
+static int openListener(const char* path) {
+    struct sockaddr_un address = {.sun_family = AF_UNIX};
+    if (strlen(path) >= sizeof(address.sun_path))
+        return -1;
+    strcpy(address.sun_path, path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+        return -1;
+
+    unlink(path);
+    if (bind(fd, (struct sockaddr*)&address, sizeof(address)) < 0 || listen(fd, SOMAXCONN) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// serves games on a unix socket until SIGINT or SIGTERM, with -t workers
+int main(int argc, char* argv[]) {
+    char* path = "tetris.sock";
+    int threads = cpuCount();
+
+    for (int n = 1; n < argc; n++) {
+        if (!strcmp(argv[n], "-t") && n+1 < argc)
+            threads = atoi(argv[++n]);
+        else
+            path = argv[n];
+    }
+    if (threads < 1)
+        threads = 1;
+    if (threads > POOL_MAX_THREADS)
+        threads = POOL_MAX_THREADS;
+
+    if ((listener = openListener(path)) < 0) {
+        fprintf(stderr, "couldn't listen on %s: %s\n", path, strerror(errno));
+        return 1;
+    }
+    if ((stop_event = eventfd(0, EFD_CLOEXEC)) < 0) {
+        fprintf(stderr, "couldn't create an eventfd: %s\n", strerror(errno));
+        return 1;
+    }
+
+    // the workers leave the signals to this thread
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, NULL);
+
+    struct ServerWorker workers[POOL_MAX_THREADS];
+    int started = 0;
+    for (; started < threads; started++) {
+        struct ServerWorker* worker = &workers[started];
+        worker->sessions = 0;
+        worker->requests = 0;
+        if ((worker->epoll = epoll_create1(EPOLL_CLOEXEC)) < 0)
+            break;
+
+        // only one worker is woken per connection
+        struct epoll_event accept_event = {EPOLLIN | EPOLLEXCLUSIVE, {.ptr = &listener}};
+        struct epoll_event stop = {EPOLLIN, {.ptr = &stop_event}};
+        if (epoll_ctl(worker->epoll, EPOLL_CTL_ADD, listener, &accept_event) < 0
+                || epoll_ctl(worker->epoll, EPOLL_CTL_ADD, stop_event, &stop) < 0
+                || pthread_create(&worker->thread, NULL, runServerWorker, worker) != 0) {
+            close(worker->epoll);
+            break;
+        }
+    }
+    if (started == 0) {
+        fprintf(stderr, "couldn't start any workers\n");
+        return 1;
+    }
+
+    printf("serving on %s with %d workers\n", path, started);
+    fflush(stdout);
+
+    int caught;
+    sigwait(&signals, &caught);
+
+    uint64_t one = 1;
+    if (write(stop_event, &one, sizeof(one)) < 0)
+        perror("write");
+
+    long requests = 0, sessions = 0;
+    for (int n = 0; n < started; n++) {
+        pthread_join(workers[n].thread, NULL);
+        close(workers[n].epoll);
+        requests += workers[n].requests;
+        sessions += workers[n].sessions;
+    }
+    printf("requests: %ld\n", requests);
+    printf("sessions still open: %ld\n", sessions);
+
+    close(listener);
+    unlink(path);
+    return 0;
+}
@@ -0,0 +1,202 @@
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "snapshot.h"
+#include "zobrist.h"
+
+static const char magic[4] = "TSNP";
+
+// Save files pack the colors of a row's first eight cells together in a
+// uint64_t, a byte per cell, rather than going a cell at a time.
+
+// the low 3 bits of each cell, side by side, cell n at bit 3n
+static uint32_t packRow(const char* cells) {
+    uint64_t x = 0;
+    memcpy(&x, cells, BOARD_WIDTH < 8 ? BOARD_WIDTH : 8);
+    x &= 0x0707070707070707ull;
+    // pairs of cells, then fours, then all eight
+    x = (x | x >> 5) & 0x003f003f003f003full;
+    x = (x | x >> 10) & 0x00000fff00000fffull;
+    x = (x | x >> 20) & 0xffffff;
+    for (int n = 8; n < BOARD_WIDTH; n++)
+        x |= (uint64_t)(cells[n] & 7) << 3*n;
+    return x;
+}
+
+// the reverse of packRow, with -1 wherever row has no block
+static void unpackRow(char* cells, uint32_t colors, row_t row) {
+    uint64_t x = colors & 0xffffff;
+    x = (x | x << 20) & 0x00000fff00000fffull;
+    x = (x | x << 10) & 0x003f003f003f003full;
+    x = (x | x << 5) & 0x0707070707070707ull;
+
+    // bit n of the row into byte n, then 0xff in the bytes that got one
+    uint64_t bits = (row & 0xff)*0x0101010101010101ull & 0x8040201008040201ull;
+    uint64_t filled = ((bits | ((bits & 0x7f7f7f7f7f7f7f7full) + 0x7f7f7f7f7f7f7f7full)) >> 7 & 0x0101010101010101ull)*0xff;
+    x = (x & filled) | ~filled;
+    memcpy(cells, &x, BOARD_WIDTH < 8 ? BOARD_WIDTH : 8);
+
+    for (int n = 8; n < BOARD_WIDTH; n++)
+        cells[n] = row >> n & 1 ? (char)(colors >> 3*n & 7) : -1;
+}
+
+void saveSnapshot(struct Snapshot* snapshot, const struct Game* game) {
+    snapshot->hash = game->hash;
+    snapshot->randomizer = game->randomizer;
+    snapshot->queue = game->queue;
+    snapshot->active = game->active;
+    snapshot->score = game->score;
+    snapshot->lines = game->lines;
+    snapshot->level = game->level;
+    snapshot->pieces = game->pieces;
+    snapshot->gravity_ticks = game->gravity_ticks;
+    snapshot->state = game->state;
+    snapshot->cleared = game->cleared;
+    memcpy(snapshot->cleared_rows, game->cleared_rows, sizeof(snapshot->cleared_rows));
+    memcpy(snapshot->board, game->board, sizeof(snapshot->board));
+    memcpy(snapshot->heights, game->heights, sizeof(snapshot->heights));
+    memcpy(snapshot->colors, game->colors, sizeof(snapshot->colors));
+}
+
+void loadSnapshot(struct Game* game, const struct Snapshot* snapshot) {
+    // the version isn't saved, it only has to move on from what was drawn
+    // of the game being replaced
+    game->version++;
+    game->hash = snapshot->hash;
+    game->randomizer = snapshot->randomizer;
+    game->queue = snapshot->queue;
+    game->active = snapshot->active;
+    game->score = snapshot->score;
+    game->lines = snapshot->lines;
+    game->level = snapshot->level;
+    game->pieces = snapshot->pieces;
+    game->gravity_ticks = snapshot->gravity_ticks;
+    game->state = snapshot->state;
+    game->cleared = snapshot->cleared;
+    memcpy(game->cleared_rows, snapshot->cleared_rows, sizeof(game->cleared_rows));
+    memcpy(game->board, snapshot->board, sizeof(game->board));
+    memcpy(game->heights, snapshot->heights, sizeof(game->heights));
+    memcpy(game->colors, snapshot->colors, sizeof(game->colors));
+}
+
+struct Snapshot* forkSnapshot(const struct Snapshot* snapshot, int count) {
+    struct Snapshot* copies = aligned_alloc(CACHE_LINE, (size_t)count*sizeof(struct Snapshot));
+    if (copies == NULL)
+        return NULL;
+    for (int n = 0; n < count; n++)
+        copies[n] = *snapshot;
+    return copies;
+}
+
+// the part of a snapshot written as it is
+#define SNAPSHOT_FIELDS offsetof(struct Snapshot, heights)
+
+int writeSnapshot(const char* path, const struct Snapshot* snapshot) {
+    FILE* file = fopen(path, "wb");
+    if (file == NULL)
+        return -1;
+
+    uint32_t version = SNAPSHOT_VERSION;
+    uint32_t colors[BOARD_HEIGHT];
+    for (int m = 0; m < BOARD_HEIGHT; m++) {
+        // empty rows are most of the board, skip them
+        colors[m] = snapshot->board[m] ? packRow(snapshot->colors[m]) : 0;
+    }
+
+    int failed = fwrite(magic, sizeof(magic), 1, file) != 1
+        || fwrite(&version, sizeof(version), 1, file) != 1
+        || fwrite(snapshot, SNAPSHOT_FIELDS, 1, file) != 1
+        || fwrite(colors, sizeof(colors), 1, file) != 1;
+
+    if (fclose(file) == EOF || failed)
+        return -1;
+    return 0;
+}
+
+// whether every piece is a real one, every count is in range and nothing
+// points off the board
+static int validSnapshot(const struct Snapshot* snapshot) {
+    const struct Randomizer* randomizer = &snapshot->randomizer;
+    const struct Piece* active = &snapshot->active;
+
+    if (snapshot->state > ABOUT || snapshot->cleared > 4 || (unsigned)randomizer->mode > RANDOM_BAG)
+        return 0;
+    if (snapshot->score < 0 || snapshot->lines < 0 || snapshot->pieces < 0 || snapshot->level != snapshot->lines/LINES_PER_LEVEL)
+        return 0;
+    if (snapshot->gravity_ticks < 0 || snapshot->gravity_ticks >= gravityTicks(snapshot->level))
+        return 0;
+    if ((unsigned)active->type > Z || (unsigned char)active->orientation > 3)
+        return 0;
+
+    // the whole piece on the board, drop writes to every cell of it
+    const struct Orientation* or = &orientations[active->type][(int)active->orientation];
+    if (active->x < 0 || active->x + or->w > BOARD_WIDTH || active->y < 0 || active->y + or->h > BOARD_HEIGHT)
+        return 0;
+
+    if (randomizer->bag_left > 7 || sizePieceRing(&snapshot->queue) > QUEUE_CAPACITY)
+        return 0;
+    for (int n = 0; n < randomizer->bag_left; n++) {
+        if (randomizer->bag[n] > Z)
+            return 0;
+    }
+    unsigned char type;
+    for (int n = 0; peekPieceRing(&snapshot->queue, n, &type) == 0; n++) {
+        if (type > Z)
+            return 0;
+    }
+    for (int n = 0; n < snapshot->cleared; n++) {
+        if (snapshot->cleared_rows[n] >= BOARD_HEIGHT)
+            return 0;
+    }
+
+    // a full row is always cleared as the piece filling it locks
+    for (int m = 0; m < BOARD_HEIGHT; m++) {
+        if ((snapshot->board[m] & ~FULL_ROW) || snapshot->board[m] == FULL_ROW)
+            return 0;
+    }
+    return 1;
+}
+
+int readSnapshot(const char* path, struct Snapshot* snapshot) {
+    FILE* file = fopen(path, "rb");
+    if (file == NULL)
+        return -1;
+
+    char header[4];
+    uint32_t version;
+    uint32_t colors[BOARD_HEIGHT];
+    int failed = fread(header, sizeof(header), 1, file) != 1
+        || fread(&version, sizeof(version), 1, file) != 1
+        || fread(snapshot, SNAPSHOT_FIELDS, 1, file) != 1
+        || fread(colors, sizeof(colors), 1, file) != 1
+        || fgetc(file) != EOF;
+    fclose(file);
+
+    if (failed || memcmp(header, magic, sizeof(magic)) || version != SNAPSHOT_VERSION || !validSnapshot(snapshot))
+        return -1;
+
+    columnHeights(snapshot->board, snapshot->heights);
+    for (int m = 0; m < BOARD_HEIGHT; m++) {
+        if (snapshot->board[m])
+            unpackRow(snapshot->colors[m], colors[m], snapshot->board[m]);
+        else
+            memset(snapshot->colors[m], -1, BOARD_WIDTH);
+    }
+
+    // A damaged board or queue shows up as a hash that doesn't match. The
+    // hash doesn't cover where the piece is, so check a piece still in
+    // play is clear of the stack. A piece only overlaps it when it has just
+    // spawned onto it and is about to lose, and a lost game's piece never
+    // moves again.
+    struct Game game;
+    game.version = 0;
+    loadSnapshot(&game, snapshot);
+    const struct Piece* active = &game.active;
+    int spawned = active->x == BOARD_WIDTH/2 && active->y == 0 && active->orientation == 0;
+    const struct Orientation* or = &orientations[active->type][(int)active->orientation];
+    if (game.state == GAME && !spawned && collides(&game, or, active->x, active->y))
+        return -1;
+    return zobristGame(&game) == snapshot->hash ? 0 : -1;
+}
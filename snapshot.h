@@ -0,0 +1,53 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stdint.h>
+
+#include "engine.h"
+#include "ring.h"
+
+// A whole game as plain fields, so saving and restoring one is a few
+// copies with nothing to pack or rebuild: six cache lines on the standard
+// board, against seven for struct Game. Only save files pack the colors,
+// at 3 bits a cell. Restoring one gives back a game that plays on exactly
+// as the original would, with the same hash.
+struct Snapshot {
+    _Alignas(CACHE_LINE) uint64_t hash;
+    struct Randomizer randomizer;
+    struct PieceRing queue;
+    struct Piece active;
+    int32_t score, lines, level, pieces;
+    int32_t gravity_ticks;
+    uint8_t state;
+    uint8_t cleared;
+    unsigned char cleared_rows[4];
+    row_t board[BOARD_HEIGHT];
+
+    // Not in save files, the heights follow from the board and the colors
+    // are written packed after the rest.
+    unsigned char heights[BOARD_WIDTH];
+    char colors[BOARD_HEIGHT][BOARD_WIDTH];
+};
+
+#if BOARD_WIDTH == 10 && BOARD_HEIGHT == 24
+_Static_assert(sizeof(struct Snapshot) <= 6*CACHE_LINE, "Snapshot has grown past six cache lines");
+#endif
+// a row of colors is packed into 32 bits in save files
+_Static_assert(BOARD_WIDTH <= 10, "the board doesn't fit a save file");
+
+void saveSnapshot(struct Snapshot* snapshot, const struct Game* game);
+void loadSnapshot(struct Game* game, const struct Snapshot* snapshot);
+// count copies of snapshot to explore from, free them with free
+struct Snapshot* forkSnapshot(const struct Snapshot* snapshot, int count);
+
+// A save file is "TSNP", a 32 bit version, the snapshot as it is in memory
+// up to its heights, then a 32 bit word of colors for each row. It only
+// loads on the kind of machine that wrote it.
+#define SNAPSHOT_VERSION 2
+
+int writeSnapshot(const char* path, const struct Snapshot* snapshot);
+// checks every field is in range and that the hash matches the game it
+// describes, returns -1 if not
+int readSnapshot(const char* path, struct Snapshot* snapshot);
+
+#endif
@@ -0,0 +1,59 @@
+#ifndef TRIPLE_H
+#define TRIPLE_H
+
+#include <stdatomic.h>
+
+#include "ring.h"
+
+// DEFINE_TRIPLE(Name, type) declares struct Name, three copies of type
+// handed from one writer thread to one reader thread without locks. The
+// writer fills the back copy and publishes it, the reader takes whichever
+// copy was published last. Neither ever waits for the other and the reader
+// never sees a copy while it is being written. It also defines
+//
+//   initName(buffer)
+//   backName(buffer)            the copy to write the next one into
+//   publishName(buffer)         makes the back copy the newest, returns 1
+//                               if the one it replaced was never read
+//   readName(buffer, &fresh)    the newest published copy, fresh is 1 if
+//                               it wasn't returned before
+//
+// The writer owns back and the reader front. middle is the newest
+// published copy, with TRIPLE_FRESH set until the reader takes it, and
+// publishing or reading swaps it with the caller's own.
+#define TRIPLE_FRESH 4
+
+#define DEFINE_TRIPLE(name, type) \
+struct name { \
+    type items[3]; \
+    _Alignas(CACHE_LINE) atomic_uint middle; \
+    /* only touched by the writer */ \
+    _Alignas(CACHE_LINE) unsigned back; \
+    /* only touched by the reader */ \
+    _Alignas(CACHE_LINE) unsigned front; \
+}; \
+\
+static inline void init##name(struct name* buffer) { \
+    buffer->back = 0; \
+    atomic_init(&buffer->middle, 1); \
+    buffer->front = 2; \
+} \
+\
+static inline type* back##name(struct name* buffer) { \
+    return &buffer->items[buffer->back]; \
+} \
+\
+static inline int publish##name(struct name* buffer) { \
+    unsigned old = atomic_exchange_explicit(&buffer->middle, buffer->back | TRIPLE_FRESH, memory_order_acq_rel); \
+    buffer->back = old & 3; \
+    return (old & TRIPLE_FRESH) != 0; \
+} \
+\
+static inline const type* read##name(struct name* buffer, int* fresh) { \
+    *fresh = (atomic_load_explicit(&buffer->middle, memory_order_relaxed) & TRIPLE_FRESH) != 0; \
+    if (*fresh) \
+        buffer->front = atomic_exchange_explicit(&buffer->middle, buffer->front, memory_order_acq_rel) & 3; \
+    return &buffer->items[buffer->front]; \
+}
+
+#endif
@@ -0,0 +1,88 @@
+#include "ttable.h"
+#include <stdlib.h>
+
+// the stats slot this thread counts into, handed out on first use
+static __thread int stats_slot = -1;
+static atomic_uint next_slot;
+
+// only this thread writes its slot, so a load and a store is enough and
+// there is no locked instruction on the probe path
+#define COUNT(table, counter) do { \
+    if (stats_slot < 0) \
+        stats_slot = atomic_fetch_add(&next_slot, 1) % TABLE_STAT_SLOTS; \
+    _Atomic long* c = &(table)->stats[stats_slot].counter; \
+    atomic_store_explicit(c, atomic_load_explicit(c, memory_order_relaxed) + 1, memory_order_relaxed); \
+} while (0)
+
+int initTable(struct TTable* table, int bits) {
+    size_t size = (size_t)1 << bits;
+    table->entries = aligned_alloc(64, size*sizeof(struct TEntry));
+    if (!table->entries)
+        return -1;
+
+    table->mask = size - 1;
+    clearTable(table);
+    resetTableStats(table);
+    return 0;
+}
+
+void destroyTable(struct TTable* table) {
+    free(table->entries);
+}
+
+void clearTable(struct TTable* table) {
+    for (uint64_t n = 0; n <= table->mask; n++) {
+        atomic_store_explicit(&table->entries[n].check, 0, memory_order_relaxed);
+        atomic_store_explicit(&table->entries[n].data, 0, memory_order_relaxed);
+    }
+}
+
+void resetTableStats(struct TTable* table) {
+    for (int n = 0; n < TABLE_STAT_SLOTS; n++) {
+        atomic_store(&table->stats[n].probes, 0);
+        atomic_store(&table->stats[n].hits, 0);
+        atomic_store(&table->stats[n].collisions, 0);
+        atomic_store(&table->stats[n].stores, 0);
+        atomic_store(&table->stats[n].overwrites, 0);
+    }
+}
+
+void tableStats(const struct TTable* table, struct TableStats* stats) {
+    *stats = (struct TableStats){0};
+    for (int n = 0; n < TABLE_STAT_SLOTS; n++) {
+        stats->probes += atomic_load(&table->stats[n].probes);
+        stats->hits += atomic_load(&table->stats[n].hits);
+        stats->collisions += atomic_load(&table->stats[n].collisions);
+        stats->stores += atomic_load(&table->stats[n].stores);
+        stats->overwrites += atomic_load(&table->stats[n].overwrites);
+    }
+}
+
+int probeTable(struct TTable* table, uint64_t key, uint64_t* data) {
+    struct TEntry* entry = &table->entries[key & table->mask];
+    uint64_t check = atomic_load_explicit(&entry->check, memory_order_relaxed);
+    uint64_t d = atomic_load_explicit(&entry->data, memory_order_relaxed);
+
+    COUNT(table, probes);
+    if (d != 0 && (check ^ d) == key) {
+        COUNT(table, hits);
+        *data = d;
+        return 1;
+    }
+    if (d != 0)
+        COUNT(table, collisions);
+    return 0;
+}
+
+void storeTable(struct TTable* table, uint64_t key, uint64_t data) {
+    struct TEntry* entry = &table->entries[key & table->mask];
+    uint64_t check = atomic_load_explicit(&entry->check, memory_order_relaxed);
+    uint64_t d = atomic_load_explicit(&entry->data, memory_order_relaxed);
+
+    COUNT(table, stores);
+    if (d != 0 && (check ^ d) != key)
+        COUNT(table, overwrites);
+
+    atomic_store_explicit(&entry->check, key ^ data, memory_order_relaxed);
+    atomic_store_explicit(&entry->data, data, memory_order_relaxed);
+}
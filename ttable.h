@@ -0,0 +1,53 @@
+#ifndef TTABLE_H
+#define TTABLE_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+// Each entry stores its key xored with its data. A reader that races a
+// writer sees a key and data that don't belong together, the xor doesn't
+// give back its key, and it treats that as a miss, so no locks are needed.
+// Data of 0 marks an empty slot.
+struct TEntry {
+    _Atomic uint64_t check;
+    _Atomic uint64_t data;
+};
+
+// hits / probes is the hit rate, collisions are probes that found a
+// different key in their slot and overwrites are stores that evicted one
+struct TableStats {
+    long probes;
+    long hits;
+    long collisions;
+    long stores;
+    long overwrites;
+};
+
+// Each thread counts into its own slot on its own cache line, so probing
+// never writes to memory another thread is reading. Past this many
+// threads slots are shared and the counts may lose a few.
+#define TABLE_STAT_SLOTS 64
+
+struct TTable {
+    struct TEntry* entries;
+    uint64_t mask;
+
+    struct {
+        _Alignas(64) _Atomic long probes, hits, collisions, stores, overwrites;
+    } stats[TABLE_STAT_SLOTS];
+};
+
+// the table has 1 << bits entries of 16 bytes
+int initTable(struct TTable* table, int bits);
+void destroyTable(struct TTable* table);
+void clearTable(struct TTable* table);
+void resetTableStats(struct TTable* table);
+// the counts of every thread added up
+void tableStats(const struct TTable* table, struct TableStats* stats);
+
+// returns 1 and fills data if key is in the table
+int probeTable(struct TTable* table, uint64_t key, uint64_t* data);
+// data must not be 0, whatever was in the slot is replaced
+void storeTable(struct TTable* table, uint64_t key, uint64_t data);
+
+#endif
@@ -0,0 +1,154 @@
+#include "versus.h"
+#include <string.h>
+#include <time.h>
+
+// rows sent for clearing 0 to 4 at once
+static const int garbage_sent[] = {0, 0, 1, 2, 4};
+
+void initVersus(struct Versus* versus, uint64_t seed, enum RandomizerMode mode) {
+    memset(versus, 0, sizeof(*versus));
+    initGame(&versus->players[0], seed, mode);
+    initGame(&versus->players[1], seed, mode);
+    seedRng(&versus->rng, ~seed);
+}
+
+// sends and takes in garbage if player locked a piece since it had pieces
+static void settle(struct Versus* versus, int player, int pieces) {
+    struct Game* game = &versus->players[player];
+    if (game->pieces == pieces)
+        return;
+
+    int sent = garbage_sent[game->cleared];
+    int cancelled = sent < versus->garbage[player] ? sent : versus->garbage[player];
+    versus->garbage[player] -= cancelled;
+    versus->garbage[1-player] += sent - cancelled;
+
+    if (game->cleared == 0 && versus->garbage[player] > 0) {
+        addGarbage(game, versus->garbage[player], randomBelow(&versus->rng, BOARD_WIDTH));
+        versus->garbage[player] = 0;
+    }
+}
+
+void versusTick(struct Versus* versus, const unsigned char inputs[2]) {
+    for (int p = 0; p < 2; p++) {
+        struct Game* game = &versus->players[p];
+        int pieces = game->pieces;
+        step(game, inputs[p]);
+        settle(versus, p, pieces);
+
+        pieces = game->pieces;
+        tick(game);
+        settle(versus, p, pieces);
+    }
+    versus->ticks++;
+}
+
+int versusWinner(const struct Versus* versus) {
+    int playing0 = versus->players[0].state == GAME;
+    int playing1 = versus->players[1].state == GAME;
+    if (playing0 && playing1)
+        return -1;
+    if (playing0 != playing1)
+        return playing0 ? 0 : 1;
+    return 2;
+}
+
+static double nsNow() {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec*1e9 + t.tv_nsec;
+}
+
+void initRollback(struct Rollback* rollback, uint64_t seed, enum RandomizerMode mode) {
+    memset(rollback, 0, sizeof(*rollback));
+    initVersus(&rollback->state, seed, mode);
+    rollback->mispredicted = ROLLBACK_NONE;
+}
+
+int rollbackLead(const struct Rollback* rollback) {
+    // what a rollback over the whole lead would cost, with room to spare
+    int lead = rollback->tick_ns > 0 ? ROLLBACK_BUDGET_NS/(2*rollback->tick_ns) : ROLLBACK_FRAMES-1;
+    if (lead > ROLLBACK_FRAMES-1)
+        lead = ROLLBACK_FRAMES-1;
+    return lead < 1 ? 1 : lead;
+}
+
+// restores the state before the first wrong guess and runs every tick since
+// again with the inputs as they are now known
+void reconcileRollback(struct Rollback* rollback) {
+    if (rollback->mispredicted == ROLLBACK_NONE)
+        return;
+
+    struct RollbackStats* stats = &rollback->stats;
+    uint64_t now = rollback->state.ticks;
+    uint64_t from = rollback->mispredicted;
+    double start = nsNow();
+
+    // versions go on from the ticks thrown away, which may have been drawn
+    unsigned versions[2] = {rollback->state.players[0].version, rollback->state.players[1].version};
+    rollback->state = rollback->snapshots[from % ROLLBACK_FRAMES];
+    for (int p = 0; p < 2; p++)
+        rollback->state.players[p].version = versions[p] + 1;
+    for (uint64_t t = from; t < now; t++) {
+        rollback->snapshots[t % ROLLBACK_FRAMES] = rollback->state;
+        versusTick(&rollback->state, rollback->inputs[t % ROLLBACK_FRAMES]);
+    }
+    rollback->mispredicted = ROLLBACK_NONE;
+
+    double spent = nsNow() - start;
+    stats->rollbacks++;
+    stats->resimulated += now - from;
+    stats->rollback_ns += spent;
+    if (spent > stats->rollback_max_ns)
+        stats->rollback_max_ns = spent;
+}
+
+int advanceRollback(struct Rollback* rollback, enum Input local) {
+    struct RollbackStats* stats = &rollback->stats;
+    reconcileRollback(rollback);
+
+    uint64_t t = rollback->state.ticks;
+    if (t >= rollback->confirmed + rollbackLead(rollback)) {
+        stats->stalls++;
+        return -1;
+    }
+
+    unsigned char* inputs = rollback->inputs[t % ROLLBACK_FRAMES];
+    inputs[0] = local;
+    inputs[1] = t < rollback->confirmed ? rollback->early[t % ROLLBACK_FRAMES] : INPUT_NONE;
+
+    double start = nsNow();
+    rollback->snapshots[t % ROLLBACK_FRAMES] = rollback->state;
+    double copied = nsNow();
+    versusTick(&rollback->state, inputs);
+    double ticked = nsNow();
+
+    stats->ticks++;
+    stats->snapshot_ns += copied - start;
+    if (copied - start > stats->snapshot_max_ns)
+        stats->snapshot_max_ns = copied - start;
+    // weighted towards recent ticks, which are what a rollback would rerun
+    rollback->tick_ns = rollback->tick_ns > 0 ? 0.95*rollback->tick_ns + 0.05*(ticked - copied) : ticked - copied;
+    return 0;
+}
+
+int remoteInput(struct Rollback* rollback, uint64_t at, enum Input input) {
+    uint64_t now = rollback->state.ticks;
+    if (at < rollback->confirmed)
+        return -1;
+    if (at >= now + ROLLBACK_FRAMES)
+        return 1;
+
+    for (uint64_t t = rollback->confirmed; t <= at; t++) {
+        unsigned char actual = t == at ? input : INPUT_NONE;
+        if (t >= now) {
+            rollback->early[t % ROLLBACK_FRAMES] = actual;
+        } else if (rollback->inputs[t % ROLLBACK_FRAMES][1] != actual) {
+            rollback->inputs[t % ROLLBACK_FRAMES][1] = actual;
+            if (t < rollback->mispredicted)
+                rollback->mispredicted = t;
+        }
+    }
+    rollback->confirmed = at+1;
+    return 0;
+}
@@ -0,0 +1,78 @@
+#ifndef VERSUS_H
+#define VERSUS_H
+
+#include <stdint.h>
+
+#include "engine.h"
+#include "rng.h"
+
+// Two games played against each other. Rows one player clears are sent to
+// the other as garbage, 1 for a double, 2 for a triple and 4 for a tetris,
+// less whatever the sender had waiting for them. Waiting garbage goes in
+// from the bottom when the receiver next locks a piece without clearing.
+struct Versus {
+    struct Game players[2];
+    int garbage[2];
+    // picks the hole in each garbage row
+    struct Rng rng;
+    uint64_t ticks;
+};
+
+// both players get the same pieces
+void initVersus(struct Versus* versus, uint64_t seed, enum RandomizerMode mode);
+// steps then ticks each player, inputs holds an enum Input for each
+void versusTick(struct Versus* versus, const unsigned char inputs[2]);
+// -1 while both are playing, otherwise the player left or 2 if neither is
+int versusWinner(const struct Versus* versus);
+
+// Player 0 is local and player 1 remote. Ticks run as soon as the local
+// input is known, guessing the remote player did nothing where their input
+// hasn't arrived. The state before each recent tick is kept, so a late
+// input that differs from the guess rolls back to that tick and simulates
+// forward again. How far ahead of the remote inputs the simulation may run
+// is held to what can be simulated again within ROLLBACK_BUDGET_NS.
+#define ROLLBACK_FRAMES 32
+#define ROLLBACK_BUDGET_NS 1000000
+
+struct RollbackStats {
+    long ticks;
+    long stalls;
+    long rollbacks;
+    long resimulated;
+    double snapshot_ns, snapshot_max_ns;
+    double rollback_ns, rollback_max_ns;
+};
+
+struct Rollback {
+    struct Versus state;
+    // remote inputs are known for every tick before confirmed
+    uint64_t confirmed;
+    // the first tick simulated with a wrong guess, ROLLBACK_NONE if none
+    uint64_t mispredicted;
+    // for tick t, the state before it and the inputs it ran with, at t % ROLLBACK_FRAMES
+    struct Versus snapshots[ROLLBACK_FRAMES];
+    unsigned char inputs[ROLLBACK_FRAMES][2];
+    // remote inputs that arrived before their tick ran
+    unsigned char early[ROLLBACK_FRAMES];
+    // average cost of simulating one tick
+    double tick_ns;
+    struct RollbackStats stats;
+};
+
+#define ROLLBACK_NONE UINT64_MAX
+
+void initRollback(struct Rollback* rollback, uint64_t seed, enum RandomizerMode mode);
+// rolls back if needed then runs the next tick, returns -1 without running
+// it if that would get too far ahead of the remote inputs
+int advanceRollback(struct Rollback* rollback, enum Input local);
+// the remote input for tick at, with no input on any tick since the last
+// one given. Returns 1 if at is too far ahead to take yet, -1 if it is
+// before an input already given.
+int remoteInput(struct Rollback* rollback, uint64_t at, enum Input input);
+// rolls back and simulates forward again if a remote input has turned out
+// to differ from the guess, advanceRollback does this first too
+void reconcileRollback(struct Rollback* rollback);
+// ticks the simulation may run past the last confirmed remote input
+int rollbackLead(const struct Rollback* rollback);
+
+#endif
@@ -0,0 +1,49 @@
+#include "zobrist.h"
+
+// splitmix64's finalizer, a bijection so distinct inputs get distinct keys
+static uint64_t mix(uint64_t z) {
+    z += 0x9e3779b97f4a7c15;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+    return z ^ (z >> 31);
+}
+
+uint64_t zobristRow(int y, row_t row) {
+    if (!row)
+        return 0;
+#if BOARD_WIDTH <= 16
+    return mix((uint64_t)y << 16 | row);
+#elif BOARD_WIDTH <= 64
+    // too wide to sit beside y, so it is mixed on its own first
+    return mix(mix(row) ^ y);
+#else
+    return mix(mix(mix((uint64_t)row) ^ (uint64_t)(row >> 64)) ^ y);
+#endif
+}
+
+uint64_t zobristActive(enum piece_type type) {
+    return mix(1ull << 32 | type);
+}
+
+uint64_t zobristQueued(int position, enum piece_type type) {
+    return mix(2ull << 32 | position << 3 | type);
+}
+
+uint64_t zobristBoard(const row_t* board) {
+    uint64_t hash = 0;
+    for (int y = 0; y < BOARD_HEIGHT; y++)
+        hash ^= zobristRow(y, board[y]);
+    return hash;
+}
+
+uint64_t zobristPieces(const struct Game* game) {
+    uint64_t hash = zobristActive(game->active.type);
+    unsigned char type;
+    for (int n = 0; peekPieceRing(&game->queue, n, &type) == 0; n++)
+        hash ^= zobristQueued(n, type);
+    return hash;
+}
+
+uint64_t zobristGame(const struct Game* game) {
+    return zobristBoard(game->board) ^ zobristPieces(game);
+}
@@ -0,0 +1,21 @@
+#ifndef ZOBRIST_H
+#define ZOBRIST_H
+
+#include <stdint.h>
+
+#include "engine.h"
+
+// Keys are a mix of what they stand for rather than a random table, so
+// there is nothing to set up and they are the same in every process.
+// The board is hashed a row at a time: each (y, row contents) pair has
+// its own key and an empty row hashes to 0.
+uint64_t zobristRow(int y, row_t row);
+uint64_t zobristActive(enum piece_type type);
+uint64_t zobristQueued(int position, enum piece_type type);
+
+uint64_t zobristBoard(const row_t* board);
+// the active piece type and the queue, the part of game->hash that isn't board
+uint64_t zobristPieces(const struct Game* game);
+uint64_t zobristGame(const struct Game* game);
+
+#endif